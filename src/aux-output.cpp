@@ -0,0 +1,162 @@
+/******************************************************************************
+	Copyright (C) 2016-2024 DistroAV <contact@distroav.org>
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation; either version 2
+	of the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, see <https://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "aux-output.h"
+
+#include "plugin-main.h"
+#include "ndi-source-output.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+struct aux_output {
+	QString ndi_name;
+	int target;
+	ndi_source_output_t *source_output;
+
+	// Set from the source output's sender monitor thread
+	std::atomic<bool> tally_on_program{false};
+	std::atomic<bool> tally_on_preview{false};
+};
+
+// Not moved once created, as the sender monitor thread writes the tally through a pointer
+static std::vector<std::unique_ptr<aux_output>> aux_outputs;
+
+static void on_aux_output_tally(void *param, bool on_program, bool on_preview)
+{
+	auto aux = (aux_output *)param;
+	aux->tally_on_program.store(on_program);
+	aux->tally_on_preview.store(on_preview);
+}
+
+void aux_outputs_get_tally(const QString &name, bool *on_program, bool *on_preview)
+{
+	*on_program = false;
+	*on_preview = false;
+	for (auto &aux : aux_outputs) {
+		if (aux->ndi_name == name) {
+			*on_program = aux->tally_on_program.load();
+			*on_preview = aux->tally_on_preview.load();
+			return;
+		}
+	}
+}
+
+// The program and named sources are followed by the source outputs themselves, only the
+// preview scene is tracked here.
+static void aux_outputs_update_preview()
+{
+	obs_source_t *preview = nullptr;
+	for (auto &aux : aux_outputs) {
+		if (aux->target != AuxOutput::TargetPreview)
+			continue;
+		if (!preview)
+			preview = obs_frontend_preview_program_mode_active() ? obs_frontend_get_current_preview_scene()
+									     : obs_frontend_get_current_scene();
+		ndi_source_output_set_source(aux->source_output, preview);
+	}
+	obs_source_release(preview);
+}
+
+static void on_aux_outputs_frontend_event(enum obs_frontend_event event, void *)
+{
+	switch (event) {
+	case OBS_FRONTEND_EVENT_SCENE_CHANGED:
+	case OBS_FRONTEND_EVENT_PREVIEW_SCENE_CHANGED:
+	case OBS_FRONTEND_EVENT_STUDIO_MODE_ENABLED:
+	case OBS_FRONTEND_EVENT_STUDIO_MODE_DISABLED:
+	case OBS_FRONTEND_EVENT_SCENE_COLLECTION_CHANGED:
+		obs_log(LOG_DEBUG, "on_aux_outputs_frontend_event(%d)", event);
+		aux_outputs_update_preview();
+		break;
+	case OBS_FRONTEND_EVENT_SCENE_COLLECTION_CLEANUP:
+		for (auto &aux : aux_outputs) {
+			if (aux->target == AuxOutput::TargetPreview)
+				ndi_source_output_set_source(aux->source_output, nullptr);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+void aux_outputs_deinit()
+{
+	obs_log(LOG_DEBUG, "+aux_outputs_deinit()");
+	if (!aux_outputs.empty()) {
+		obs_frontend_remove_event_callback(on_aux_outputs_frontend_event, nullptr);
+		for (auto &aux : aux_outputs) {
+			obs_log(LOG_DEBUG, "aux_outputs_deinit: releasing NDI output '%s'", QT_TO_UTF8(aux->ndi_name));
+			ndi_source_output_destroy(aux->source_output);
+		}
+		aux_outputs.clear();
+	}
+	obs_log(LOG_DEBUG, "-aux_outputs_deinit()");
+}
+
+void aux_outputs_init()
+{
+	obs_log(LOG_DEBUG, "+aux_outputs_init()");
+
+	aux_outputs_deinit();
+
+	for (const auto &config : Config::Current()->AuxOutputs) {
+		if (!config.Enabled || config.Name.isEmpty())
+			continue;
+		if (config.Target == AuxOutput::TargetSource && config.Source.isEmpty())
+			continue;
+
+		// Kept alive until the output is created
+		QByteArray name = config.Name.toUtf8();
+		QByteArray groups = config.Groups.toUtf8();
+		QByteArray source_name = config.Source.toUtf8();
+
+		ndi_source_output_info_t info = {};
+		info.ndi_name = name.constData();
+		info.ndi_groups = groups.isEmpty() ? nullptr : groups.constData();
+		info.source_name = config.Target == AuxOutput::TargetSource ? source_name.constData() : nullptr;
+		info.program = config.Target == AuxOutput::TargetProgram;
+		info.height = (uint32_t)std::max(config.Resolution, 0);
+		info.pixel_format = (ndi_pixel_format_t)std::clamp(config.PixelFormat, (int)NDI_PIXEL_FORMAT_BGRA,
+								   (int)NDI_PIXEL_FORMAT_UYVA);
+		info.frame_divisor = (uint32_t)std::max(config.FrameDivisor, 1);
+
+		auto aux = std::make_unique<aux_output>();
+		aux->ndi_name = config.Name;
+		aux->target = config.Target;
+		info.tally_callback = on_aux_output_tally;
+		info.tally_param = aux.get();
+
+		aux->source_output = ndi_source_output_create(&info);
+		if (!aux->source_output) {
+			obs_log(LOG_ERROR, "ERR-400 - Failed to start NDI output '%s'", name.constData());
+			continue;
+		}
+
+		obs_log(LOG_DEBUG, "aux_outputs_init: started NDI output '%s'", name.constData());
+		aux_outputs.push_back(std::move(aux));
+	}
+
+	if (!aux_outputs.empty()) {
+		aux_outputs_update_preview();
+		obs_frontend_add_event_callback(on_aux_outputs_frontend_event, nullptr);
+	}
+
+	obs_log(LOG_DEBUG, "-aux_outputs_init()");
+}
@@ -0,0 +1,25 @@
+/******************************************************************************
+	Copyright (C) 2016-2024 DistroAV <contact@distroav.org>
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation; either version 2
+	of the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, see <https://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+#include <QString>
+
+// Auxiliary NDI outputs (Config::AuxOutputs), each rendered from its own source
+void aux_outputs_deinit();
+void aux_outputs_init();
+// Downstream tally of the running output named `name`, false for both if there is none
+void aux_outputs_get_tally(const QString &name, bool *on_program, bool *on_preview);
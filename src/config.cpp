@@ -22,6 +22,9 @@
 #include <util/config-file.h>
 
 #include <QCoreApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
 
 #define SECTION_NAME "NDIPlugin"
 
@@ -29,9 +32,17 @@
 #define PARAM_MAIN_OUTPUT_ENABLED "MainOutputEnabled"
 #define PARAM_MAIN_OUTPUT_NAME "MainOutputName"
 #define PARAM_MAIN_OUTPUT_GROUPS "MainOutputGroups"
+#define PARAM_MAIN_OUTPUT_PACING "MainOutputPacing"
+#define PARAM_MAIN_OUTPUT_FRAME_DIVISOR "MainOutputFrameDivisor"
+#define PARAM_MAIN_OUTPUT_ALPHA "MainOutputAlpha"
+#define PARAM_MAIN_OUTPUT_AUDIO_FRAME_SAMPLES "MainOutputAudioFrameSamples"
+#define PARAM_MAIN_OUTPUT_IDLE_KEEPALIVE "MainOutputIdleKeepalive"
 #define PARAM_PREVIEW_OUTPUT_ENABLED "PreviewOutputEnabled"
 #define PARAM_PREVIEW_OUTPUT_NAME "PreviewOutputName"
 #define PARAM_PREVIEW_OUTPUT_GROUPS "PreviewOutputGroups"
+#define PARAM_PREVIEW_OUTPUT_RESOLUTION "PreviewOutputResolution"
+#define PARAM_PREVIEW_OUTPUT_FRAME_DIVISOR "PreviewOutputFrameDivisor"
+#define PARAM_AUX_OUTPUTS "AuxOutputs"
 #define PARAM_TALLY_PROGRAM_ENABLED "TallyProgramEnabled"
 #define PARAM_TALLY_PREVIEW_ENABLED "TallyPreviewEnabled"
 #define PARAM_SKIP_UPDATE_VERSION "SkipUpdateVersion"
@@ -52,6 +63,7 @@ bool Config::CheckObsForceFail = false;
 bool Config::CheckNdiLibBypass = false;
 bool Config::CheckObsBypass = false;
 int Config::DetectObsNdiForce = 0;
+int Config::ReadbackDepth = 0;
 
 enum ObsConfigType { OBS_CONFIG_STRING, OBS_CONFIG_BOOL };
 
@@ -168,6 +180,21 @@ void ProcessCommandLine()
 			continue;
 		}
 
+		//
+		// Readback
+		//
+		if (argument.startsWith("--distroav-readback-depth")) {
+			auto parts = argument.split("=");
+			if (parts.size() > 1) {
+				auto depth = parts.at(1).toInt();
+				if (depth >= 0) {
+					Config::ReadbackDepth = depth;
+					obs_log(LOG_INFO, "config: DistroAV readback depth set to %d", Config::ReadbackDepth);
+				}
+			}
+			continue;
+		}
+
 		//
 		// OBS-NDI Detection
 		//
@@ -210,13 +237,69 @@ void MigrateSetting(config_t *from, config_t *to, const char *section, const cha
 	obs_log(LOG_INFO, "config: migrated configuration setting %s", name);
 }
 
+bool AuxOutput::operator==(const AuxOutput &other) const
+{
+	return Enabled == other.Enabled && Name == other.Name && Groups == other.Groups && Target == other.Target &&
+	       Source == other.Source && Resolution == other.Resolution && PixelFormat == other.PixelFormat &&
+	       FrameDivisor == other.FrameDivisor;
+}
+
+// Auxiliary outputs are stored as a single JSON array, as the config file has no list type
+static QList<AuxOutput> AuxOutputsFromJson(const char *json)
+{
+	QList<AuxOutput> aux_outputs;
+	if (!json || !json[0])
+		return aux_outputs;
+
+	auto document = QJsonDocument::fromJson(QByteArray(json));
+	for (const auto &value : document.array()) {
+		auto object = value.toObject();
+		AuxOutput aux_output;
+		aux_output.Enabled = object["enabled"].toBool(true);
+		aux_output.Name = object["name"].toString();
+		aux_output.Groups = object["groups"].toString();
+		aux_output.Target = object["target"].toInt(AuxOutput::TargetProgram);
+		aux_output.Source = object["source"].toString();
+		aux_output.Resolution = object["resolution"].toInt(0);
+		aux_output.PixelFormat = object["pixel_format"].toInt(1);
+		aux_output.FrameDivisor = object["frame_divisor"].toInt(1);
+		aux_outputs.append(aux_output);
+	}
+	return aux_outputs;
+}
+
+static QByteArray AuxOutputsToJson(const QList<AuxOutput> &aux_outputs)
+{
+	QJsonArray array;
+	for (const auto &aux_output : aux_outputs) {
+		QJsonObject object;
+		object["enabled"] = aux_output.Enabled;
+		object["name"] = aux_output.Name;
+		object["groups"] = aux_output.Groups;
+		object["target"] = aux_output.Target;
+		object["source"] = aux_output.Source;
+		object["resolution"] = aux_output.Resolution;
+		object["pixel_format"] = aux_output.PixelFormat;
+		object["frame_divisor"] = aux_output.FrameDivisor;
+		array.append(object);
+	}
+	return QJsonDocument(array).toJson(QJsonDocument::Compact);
+}
+
 Config::Config()
 	: OutputEnabled(false),
 	  OutputName("OBS PGM"),
 	  OutputGroups(""),
+	  OutputPacing(0),
+	  OutputFrameDivisor(1),
+	  OutputAlpha(false),
+	  OutputAudioFrameSamples(AUDIO_OUTPUT_FRAMES),
+	  OutputIdleKeepalive(true),
 	  PreviewOutputEnabled(false),
 	  PreviewOutputName("OBS Preview"),
 	  PreviewOutputGroups(""),
+	  PreviewOutputResolution(0),
+	  PreviewOutputFrameDivisor(1),
 	  TallyProgramEnabled(true),
 	  TallyPreviewEnabled(true)
 {
@@ -233,12 +316,26 @@ void Config::SetDefaultsToUserStore()
 		config_set_default_bool(obs_config, SECTION_NAME, PARAM_MAIN_OUTPUT_ENABLED, OutputEnabled);
 		config_set_default_string(obs_config, SECTION_NAME, PARAM_MAIN_OUTPUT_NAME, QT_TO_UTF8(OutputName));
 		config_set_default_string(obs_config, SECTION_NAME, PARAM_MAIN_OUTPUT_GROUPS, QT_TO_UTF8(OutputGroups));
+		config_set_default_int(obs_config, SECTION_NAME, PARAM_MAIN_OUTPUT_PACING, OutputPacing);
+		config_set_default_int(obs_config, SECTION_NAME, PARAM_MAIN_OUTPUT_FRAME_DIVISOR, OutputFrameDivisor);
+		config_set_default_bool(obs_config, SECTION_NAME, PARAM_MAIN_OUTPUT_ALPHA, OutputAlpha);
+		config_set_default_int(obs_config, SECTION_NAME, PARAM_MAIN_OUTPUT_AUDIO_FRAME_SAMPLES,
+				       OutputAudioFrameSamples);
+		config_set_default_bool(obs_config, SECTION_NAME, PARAM_MAIN_OUTPUT_IDLE_KEEPALIVE,
+					OutputIdleKeepalive);
 
 		config_set_default_bool(obs_config, SECTION_NAME, PARAM_PREVIEW_OUTPUT_ENABLED, PreviewOutputEnabled);
 		config_set_default_string(obs_config, SECTION_NAME, PARAM_PREVIEW_OUTPUT_NAME,
 					  QT_TO_UTF8(PreviewOutputName));
 		config_set_default_string(obs_config, SECTION_NAME, PARAM_PREVIEW_OUTPUT_GROUPS,
 					  QT_TO_UTF8(PreviewOutputGroups));
+		config_set_default_int(obs_config, SECTION_NAME, PARAM_PREVIEW_OUTPUT_RESOLUTION,
+				       PreviewOutputResolution);
+		config_set_default_int(obs_config, SECTION_NAME, PARAM_PREVIEW_OUTPUT_FRAME_DIVISOR,
+				       PreviewOutputFrameDivisor);
+
+		config_set_default_string(obs_config, SECTION_NAME, PARAM_AUX_OUTPUTS,
+					  AuxOutputsToJson(AuxOutputs).constData());
 
 		config_set_default_bool(obs_config, SECTION_NAME, PARAM_TALLY_PROGRAM_ENABLED, TallyProgramEnabled);
 		config_set_default_bool(obs_config, SECTION_NAME, PARAM_TALLY_PREVIEW_ENABLED, TallyPreviewEnabled);
@@ -276,10 +373,22 @@ void Config::Load()
 		OutputEnabled = config_get_bool(obs_config, SECTION_NAME, PARAM_MAIN_OUTPUT_ENABLED);
 		OutputName = config_get_string(obs_config, SECTION_NAME, PARAM_MAIN_OUTPUT_NAME);
 		OutputGroups = config_get_string(obs_config, SECTION_NAME, PARAM_MAIN_OUTPUT_GROUPS);
+		OutputPacing = (int)config_get_int(obs_config, SECTION_NAME, PARAM_MAIN_OUTPUT_PACING);
+		OutputFrameDivisor = (int)config_get_int(obs_config, SECTION_NAME, PARAM_MAIN_OUTPUT_FRAME_DIVISOR);
+		OutputAlpha = config_get_bool(obs_config, SECTION_NAME, PARAM_MAIN_OUTPUT_ALPHA);
+		OutputAudioFrameSamples =
+			(int)config_get_int(obs_config, SECTION_NAME, PARAM_MAIN_OUTPUT_AUDIO_FRAME_SAMPLES);
+		OutputIdleKeepalive = config_get_bool(obs_config, SECTION_NAME, PARAM_MAIN_OUTPUT_IDLE_KEEPALIVE);
 
 		PreviewOutputEnabled = config_get_bool(obs_config, SECTION_NAME, PARAM_PREVIEW_OUTPUT_ENABLED);
 		PreviewOutputName = config_get_string(obs_config, SECTION_NAME, PARAM_PREVIEW_OUTPUT_NAME);
 		PreviewOutputGroups = config_get_string(obs_config, SECTION_NAME, PARAM_PREVIEW_OUTPUT_GROUPS);
+		PreviewOutputResolution =
+			(int)config_get_int(obs_config, SECTION_NAME, PARAM_PREVIEW_OUTPUT_RESOLUTION);
+		PreviewOutputFrameDivisor =
+			(int)config_get_int(obs_config, SECTION_NAME, PARAM_PREVIEW_OUTPUT_FRAME_DIVISOR);
+
+		AuxOutputs = AuxOutputsFromJson(config_get_string(obs_config, SECTION_NAME, PARAM_AUX_OUTPUTS));
 
 		TallyProgramEnabled = config_get_bool(obs_config, SECTION_NAME, PARAM_TALLY_PROGRAM_ENABLED);
 		TallyPreviewEnabled = config_get_bool(obs_config, SECTION_NAME, PARAM_TALLY_PREVIEW_ENABLED);
@@ -293,11 +402,22 @@ void Config::Save()
 		config_set_bool(obs_config, SECTION_NAME, PARAM_MAIN_OUTPUT_ENABLED, OutputEnabled);
 		config_set_string(obs_config, SECTION_NAME, PARAM_MAIN_OUTPUT_NAME, QT_TO_UTF8(OutputName));
 		config_set_string(obs_config, SECTION_NAME, PARAM_MAIN_OUTPUT_GROUPS, QT_TO_UTF8(OutputGroups));
+		config_set_int(obs_config, SECTION_NAME, PARAM_MAIN_OUTPUT_PACING, OutputPacing);
+		config_set_int(obs_config, SECTION_NAME, PARAM_MAIN_OUTPUT_FRAME_DIVISOR, OutputFrameDivisor);
+		config_set_bool(obs_config, SECTION_NAME, PARAM_MAIN_OUTPUT_ALPHA, OutputAlpha);
+		config_set_int(obs_config, SECTION_NAME, PARAM_MAIN_OUTPUT_AUDIO_FRAME_SAMPLES,
+			       OutputAudioFrameSamples);
+		config_set_bool(obs_config, SECTION_NAME, PARAM_MAIN_OUTPUT_IDLE_KEEPALIVE, OutputIdleKeepalive);
 
 		config_set_bool(obs_config, SECTION_NAME, PARAM_PREVIEW_OUTPUT_ENABLED, PreviewOutputEnabled);
 		config_set_string(obs_config, SECTION_NAME, PARAM_PREVIEW_OUTPUT_NAME, QT_TO_UTF8(PreviewOutputName));
 		config_set_string(obs_config, SECTION_NAME, PARAM_PREVIEW_OUTPUT_GROUPS,
 				  QT_TO_UTF8(PreviewOutputGroups));
+		config_set_int(obs_config, SECTION_NAME, PARAM_PREVIEW_OUTPUT_RESOLUTION, PreviewOutputResolution);
+		config_set_int(obs_config, SECTION_NAME, PARAM_PREVIEW_OUTPUT_FRAME_DIVISOR, PreviewOutputFrameDivisor);
+
+		config_set_string(obs_config, SECTION_NAME, PARAM_AUX_OUTPUTS,
+				  AuxOutputsToJson(AuxOutputs).constData());
 
 		config_set_bool(obs_config, SECTION_NAME, PARAM_TALLY_PROGRAM_ENABLED, TallyProgramEnabled);
 		config_set_bool(obs_config, SECTION_NAME, PARAM_TALLY_PREVIEW_ENABLED, TallyPreviewEnabled);
@@ -18,6 +18,7 @@
 #pragma once
 
 #include <QDateTime>
+#include <QList>
 #include <QString>
 #include <QVersionNumber>
 
@@ -42,8 +43,38 @@
  * AutoCheckForUpdates=true
  * MainOutputGroups=
  * PreviewOutputGroups=
+ * MainOutputPacing=0
+ * MainOutputFrameDivisor=1
+ * MainOutputAlpha=false
+ * MainOutputAudioFrameSamples=1024
+ * MainOutputIdleKeepalive=true
+ * PreviewOutputResolution=0
+ * PreviewOutputFrameDivisor=1
+ * AuxOutputs=[{"name":"OBS Cam 1","groups":"","target":2,"source":"Camera 1",...}]
  * ```
  */
+
+// Additional NDI output, rendered from the program, the preview or a given scene/source
+struct AuxOutput {
+	enum TargetType { TargetProgram = 0, TargetPreview = 1, TargetSource = 2 };
+
+	bool Enabled = true;
+	QString Name;
+	QString Groups;
+	int Target = TargetProgram; // TargetType
+	// Scene or source name, for TargetSource
+	QString Source;
+	// Output height, the width following the canvas aspect ratio (0 = canvas size)
+	int Resolution = 0;
+	// ndi_pixel_format_t
+	int PixelFormat = 1;
+	// Only every Nth canvas frame is sent (1 = canvas frame rate)
+	int FrameDivisor = 1;
+
+	bool operator==(const AuxOutput &other) const;
+	bool operator!=(const AuxOutput &other) const { return !(*this == other); }
+};
+
 class Config {
 public:
 	static void Initialize();
@@ -80,13 +111,34 @@ public:
 	 *  1 = `--DistroAV-detect-obsndi-force=on` : force OBS-NDI detected
 	 */
 	static int DetectObsNdiForce;
+	/**
+	 * Number of staging surfaces used to read back preview and filter frames (1-4)
+	 * 0 = default
+	 * `--distroav-readback-depth=1` : map synchronously, to compare render thread timings
+	 */
+	static int ReadbackDepth;
 
 	bool OutputEnabled;
 	QString OutputName;
 	QString OutputGroups;
+	// ndi_send_pacing_t: 0 = none, 1 = paced by DistroAV, 2 = clocked by NDI
+	int OutputPacing;
+	// Only every Nth canvas frame is sent (1 = canvas frame rate)
+	int OutputFrameDivisor;
+	// Send the program with its transparency as UYVA, whatever the canvas color format
+	bool OutputAlpha;
+	// Audio samples per NDI frame, a multiple of OBS's 1024 samples audio frames
+	int OutputAudioFrameSamples;
+	// With no receiver connected, still send one frame per second instead of none
+	bool OutputIdleKeepalive;
 	bool PreviewOutputEnabled;
 	QString PreviewOutputName;
 	QString PreviewOutputGroups;
+	// Output height, the width following the canvas aspect ratio (0 = canvas size)
+	int PreviewOutputResolution;
+	// Only every Nth canvas frame is sent (1 = canvas frame rate)
+	int PreviewOutputFrameDivisor;
+	QList<AuxOutput> AuxOutputs;
 	bool TallyProgramEnabled;
 	bool TallyPreviewEnabled;
 
@@ -20,7 +20,10 @@
 #include "plugin-main.h"
 #include "main-output.h"
 #include "preview-output.h"
+#include "aux-output.h"
 #include "update.h"
+#include "ndi-readback.h"
+#include "ndi-send-queue.h"
 
 #include <QClipboard>
 #include <QDesktopServices>
@@ -30,6 +33,7 @@
 #include <QPointer>
 #include <QPushButton>
 #include <QRegularExpression>
+#include <QHeaderView>
 
 OutputSettings::OutputSettings(QWidget *parent) : QDialog(parent), ui(new Ui::OutputSettings)
 {
@@ -37,6 +41,46 @@ OutputSettings::OutputSettings(QWidget *parent) : QDialog(parent), ui(new Ui::Ou
 
 	connect(ui->buttonBox, SIGNAL(accepted()), this, SLOT(onFormAccepted()));
 
+	ui->mainOutputPacing->addItem(QTStr("NDIPlugin.OutputSettings.Main.Pacing.None"), NDI_SEND_PACING_NONE);
+	ui->mainOutputPacing->addItem(QTStr("NDIPlugin.OutputSettings.Main.Pacing.Paced"), NDI_SEND_PACING_PACED);
+	ui->mainOutputPacing->addItem(QTStr("NDIPlugin.OutputSettings.Main.Pacing.Clocked"), NDI_SEND_PACING_CLOCKED);
+
+	// Multiples of OBS's audio frames, up to the 8192 samples ndi_output aggregates at most
+	for (int samples = AUDIO_OUTPUT_FRAMES; samples <= AUDIO_OUTPUT_FRAMES * 8; samples *= 2)
+		ui->mainOutputAudioFrameSamples->addItem(
+			QTStr("NDIPlugin.OutputSettings.Main.AudioFrameSamples.Samples").arg(samples), samples);
+
+	ui->previewOutputResolution->addItem(QTStr("NDIPlugin.OutputSettings.Preview.Resolution.Canvas"), 0);
+	for (int height : {1080, 720, 540, 360})
+		ui->previewOutputResolution->addItem(QString("%1p").arg(height), height);
+
+	for (auto frameRate : {ui->mainOutputFrameRate, ui->previewOutputFrameRate}) {
+		frameRate->addItem(QTStr("NDIPlugin.FrameRate.Canvas"), 1);
+		frameRate->addItem(QTStr("NDIPlugin.FrameRate.Half"), 2);
+		frameRate->addItem(QTStr("NDIPlugin.FrameRate.Third"), 3);
+		frameRate->addItem(QTStr("NDIPlugin.FrameRate.Quarter"), 4);
+	}
+
+	ui->auxOutputsTable->setColumnCount(7);
+	ui->auxOutputsTable->setHorizontalHeaderLabels(
+		{QTStr("NDIPlugin.OutputSettings.Aux.Name"), QTStr("NDIPlugin.OutputSettings.Aux.Groups"),
+		 QTStr("NDIPlugin.OutputSettings.Aux.Source"), QTStr("NDIPlugin.OutputSettings.Aux.Resolution"),
+		 QTStr("NDIPlugin.OutputSettings.Aux.PixelFormat"), QTStr("NDIPlugin.OutputSettings.Aux.FrameRate"),
+		 QTStr("NDIPlugin.OutputSettings.Aux.Tally")});
+	ui->auxOutputsTable->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+	ui->auxOutputsTable->verticalHeader()->setVisible(false);
+
+	connect(ui->auxOutputsAdd, &QPushButton::clicked, [this]() {
+		AuxOutput auxOutput;
+		auxOutput.Name = QString("OBS Output %1").arg(ui->auxOutputsTable->rowCount() + 1);
+		addAuxOutputRow(auxOutput);
+	});
+	connect(ui->auxOutputsRemove, &QPushButton::clicked, [this]() {
+		auto row = ui->auxOutputsTable->currentRow();
+		if (row >= 0)
+			ui->auxOutputsTable->removeRow(row);
+	});
+
 	// Requirements checks and status display
 	// Global rules for color based on requirement checks: red for fail, green for pass. Text is set per check below.
 	auto applyStatus = [](QLabel *label, bool ok, const QString &message) {
@@ -292,18 +336,28 @@ void OutputSettings::onFormAccepted()
 	config->OutputName = ui->mainOutputName->text();
 	replace_invalid_filename_chars(&config->OutputName);
 	config->OutputGroups = ui->mainOutputGroups->text();
+	config->OutputPacing = ui->mainOutputPacing->currentData().toInt();
+	config->OutputFrameDivisor = ui->mainOutputFrameRate->currentData().toInt();
+	config->OutputAlpha = ui->mainOutputAlpha->isChecked();
+	config->OutputAudioFrameSamples = ui->mainOutputAudioFrameSamples->currentData().toInt();
+	config->OutputIdleKeepalive = ui->mainOutputIdleKeepalive->isChecked();
 
 	config->PreviewOutputEnabled = ui->previewOutputGroupBox->isChecked();
 	config->PreviewOutputName = ui->previewOutputName->text();
 	replace_invalid_filename_chars(&config->PreviewOutputName);
 	config->PreviewOutputGroups = ui->previewOutputGroups->text();
+	config->PreviewOutputResolution = ui->previewOutputResolution->currentData().toInt();
+	config->PreviewOutputFrameDivisor = ui->previewOutputFrameRate->currentData().toInt();
+
+	config->AuxOutputs = auxOutputsFromTable();
 
 	config->TallyProgramEnabled = ui->tallyProgramCheckBox->isChecked();
 	config->TallyPreviewEnabled = ui->tallyPreviewCheckBox->isChecked();
 
 	config->AutoCheckForUpdates(ui->checkBoxAutoCheckForUpdates->isChecked());
 
-	auto mainSupported = ui->mainOutputGroupBox->isEnabled();
+	// Same decision as main_output_init: with alpha the canvas format does not matter
+	auto mainSupported = config->OutputAlpha || canvasSupported;
 
 	obs_log(LOG_INFO, "Main output supported='%d'", mainSupported);
 
@@ -319,8 +373,13 @@ void OutputSettings::onFormAccepted()
 	if (mainSupported && config->OutputEnabled && !config->OutputName.isEmpty()) {
 		if ((last_config.OutputEnabled != config->OutputEnabled) ||
 		    (last_config.OutputName != config->OutputName) ||
-		    (last_config.OutputGroups != config->OutputGroups)) {
-			// The Output is supported and enabled, OutputName exists and a Name or GroupName has changed since last form submission
+		    (last_config.OutputGroups != config->OutputGroups) ||
+		    (last_config.OutputPacing != config->OutputPacing) ||
+		    (last_config.OutputFrameDivisor != config->OutputFrameDivisor) ||
+		    (last_config.OutputAlpha != config->OutputAlpha) ||
+		    (last_config.OutputAudioFrameSamples != config->OutputAudioFrameSamples) ||
+		    (last_config.OutputIdleKeepalive != config->OutputIdleKeepalive)) {
+			// The Output is supported and enabled, OutputName exists and a Name, GroupName, pacing, frame rate, alpha, audio frame size or keepalive has changed since last form submission
 			obs_log(LOG_INFO, "Initializing Main output");
 			main_output_init();
 		}
@@ -330,33 +389,134 @@ void OutputSettings::onFormAccepted()
 	if (config->PreviewOutputEnabled && !config->PreviewOutputName.isEmpty()) {
 		if ((last_config.PreviewOutputEnabled != config->PreviewOutputEnabled) ||
 		    (last_config.PreviewOutputName != config->PreviewOutputName) ||
-		    (last_config.PreviewOutputGroups != config->PreviewOutputGroups)) {
-			// The Preview Output is enabled, OutputName exists and a Name or GroupName has changed since last form submission
+		    (last_config.PreviewOutputGroups != config->PreviewOutputGroups) ||
+		    (last_config.PreviewOutputResolution != config->PreviewOutputResolution) ||
+		    (last_config.PreviewOutputFrameDivisor != config->PreviewOutputFrameDivisor)) {
+			// The Preview Output is enabled, OutputName exists and a Name, GroupName, resolution or frame rate has changed since last form submission
 			obs_log(LOG_INFO, "Initializing Preview output");
 			preview_output_init();
 		}
 	} else {
 		preview_output_deinit();
 	}
+	if (last_config.AuxOutputs != config->AuxOutputs) {
+		obs_log(LOG_INFO, "Initializing additional outputs");
+		aux_outputs_init();
+	}
+}
+
+void OutputSettings::addAuxOutputRow(const AuxOutput &auxOutput)
+{
+	auto table = ui->auxOutputsTable;
+	auto row = table->rowCount();
+	table->insertRow(row);
+
+	auto nameItem = new QTableWidgetItem(auxOutput.Name);
+	nameItem->setFlags(nameItem->flags() | Qt::ItemIsUserCheckable);
+	nameItem->setCheckState(auxOutput.Enabled ? Qt::Checked : Qt::Unchecked);
+	table->setItem(row, 0, nameItem);
+	table->setItem(row, 1, new QTableWidgetItem(auxOutput.Groups));
+
+	// Program and preview, then scenes and sources by name; any other name can be typed in
+	auto source = new QComboBox(table);
+	source->setEditable(true);
+	source->addItem(QTStr("NDIPlugin.OutputSettings.Aux.Source.Program"), AuxOutput::TargetProgram);
+	source->addItem(QTStr("NDIPlugin.OutputSettings.Aux.Source.Preview"), AuxOutput::TargetPreview);
+	QStringList names;
+	auto addName = [](void *param, obs_source_t *obsSource) {
+		static_cast<QStringList *>(param)->append(QString::fromUtf8(obs_source_get_name(obsSource)));
+		return true;
+	};
+	obs_enum_scenes(addName, &names);
+	obs_enum_sources(addName, &names);
+	for (const auto &name : names)
+		source->addItem(name, AuxOutput::TargetSource);
+	if (auxOutput.Target == AuxOutput::TargetSource)
+		source->setCurrentText(auxOutput.Source);
+	else
+		source->setCurrentIndex(source->findData(auxOutput.Target));
+	table->setCellWidget(row, 2, source);
+
+	auto resolution = new QComboBox(table);
+	resolution->addItem(QTStr("NDIPlugin.OutputSettings.Preview.Resolution.Canvas"), 0);
+	for (int height : {1080, 720, 540, 360})
+		resolution->addItem(QString("%1p").arg(height), height);
+	auto resolutionIndex = resolution->findData(auxOutput.Resolution);
+	resolution->setCurrentIndex(resolutionIndex >= 0 ? resolutionIndex : 0);
+	table->setCellWidget(row, 3, resolution);
+
+	auto pixelFormat = new QComboBox(table);
+	pixelFormat->addItem(QTStr("NDIPlugin.FilterProps.PixelFormat.UYVY"), NDI_PIXEL_FORMAT_UYVY);
+	pixelFormat->addItem(QTStr("NDIPlugin.FilterProps.PixelFormat.UYVA"), NDI_PIXEL_FORMAT_UYVA);
+	pixelFormat->addItem(QTStr("NDIPlugin.FilterProps.PixelFormat.BGRA"), NDI_PIXEL_FORMAT_BGRA);
+	auto pixelFormatIndex = pixelFormat->findData(auxOutput.PixelFormat);
+	pixelFormat->setCurrentIndex(pixelFormatIndex >= 0 ? pixelFormatIndex : 0);
+	table->setCellWidget(row, 4, pixelFormat);
+
+	auto frameRate = new QComboBox(table);
+	frameRate->addItem(QTStr("NDIPlugin.FrameRate.Canvas"), 1);
+	frameRate->addItem(QTStr("NDIPlugin.FrameRate.Half"), 2);
+	frameRate->addItem(QTStr("NDIPlugin.FrameRate.Third"), 3);
+	frameRate->addItem(QTStr("NDIPlugin.FrameRate.Quarter"), 4);
+	auto frameRateIndex = frameRate->findData(auxOutput.FrameDivisor);
+	frameRate->setCurrentIndex(frameRateIndex >= 0 ? frameRateIndex : 0);
+	table->setCellWidget(row, 5, frameRate);
+
+	// Downstream tally of the running output, read-only
+	bool onProgram = false, onPreview = false;
+	aux_outputs_get_tally(auxOutput.Name, &onProgram, &onPreview);
+	auto tallyItem = new QTableWidgetItem(QTStr(onProgram   ? "NDIPlugin.OutputSettings.Aux.Tally.Program"
+						    : onPreview ? "NDIPlugin.OutputSettings.Aux.Tally.Preview"
+								: "NDIPlugin.OutputSettings.Aux.Tally.None"));
+	tallyItem->setFlags(tallyItem->flags() & ~Qt::ItemIsEditable);
+	tallyItem->setToolTip(QTStr("NDIPlugin.Downstream.ToolTip"));
+	table->setItem(row, 6, tallyItem);
+}
+
+QList<AuxOutput> OutputSettings::auxOutputsFromTable()
+{
+	QList<AuxOutput> auxOutputs;
+	auto table = ui->auxOutputsTable;
+	for (int row = 0; row < table->rowCount(); row++) {
+		AuxOutput auxOutput;
+		auxOutput.Enabled = table->item(row, 0)->checkState() == Qt::Checked;
+		auxOutput.Name = table->item(row, 0)->text();
+		replace_invalid_filename_chars(&auxOutput.Name);
+		auxOutput.Groups = table->item(row, 1) ? table->item(row, 1)->text() : QString();
+
+		auto source = static_cast<QComboBox *>(table->cellWidget(row, 2));
+		auto sourceIndex = source->findText(source->currentText());
+		auxOutput.Target = sourceIndex >= 0 ? source->itemData(sourceIndex).toInt() : AuxOutput::TargetSource;
+		if (auxOutput.Target == AuxOutput::TargetSource)
+			auxOutput.Source = source->currentText();
+
+		auxOutput.Resolution = static_cast<QComboBox *>(table->cellWidget(row, 3))->currentData().toInt();
+		auxOutput.PixelFormat = static_cast<QComboBox *>(table->cellWidget(row, 4))->currentData().toInt();
+		auxOutput.FrameDivisor = static_cast<QComboBox *>(table->cellWidget(row, 5))->currentData().toInt();
+		auxOutputs.append(auxOutput);
+	}
+	return auxOutputs;
 }
 
 void OutputSettings::showEvent(QShowEvent *)
 {
 	auto config = Config::Current();
 
-	// Enable Output (Main & Preview) settings as long as Main Output can be supported.
-
-	if (main_output_is_supported()) {
-		ui->mainOutputGroupBox->setEnabled(true);
-		ui->previewOutputGroupBox->setEnabled(true);
-	} else {
-		ui->mainOutputGroupBox->setEnabled(false);
-		ui->previewOutputGroupBox->setEnabled(false);
-	}
+	// Only the Main Output without alpha sends the canvas and needs its format to be supported.
+	// The Preview and Additional Outputs render their own sources, whatever the canvas format.
+	canvasSupported = main_output_is_supported();
 
 	ui->mainOutputGroupBox->setChecked(config->OutputEnabled);
 	ui->mainOutputName->setText(config->OutputName);
 	ui->mainOutputGroups->setText(config->OutputGroups);
+	auto pacingIndex = ui->mainOutputPacing->findData(config->OutputPacing);
+	ui->mainOutputPacing->setCurrentIndex(pacingIndex >= 0 ? pacingIndex : 0);
+	auto mainFrameRateIndex = ui->mainOutputFrameRate->findData(config->OutputFrameDivisor);
+	ui->mainOutputFrameRate->setCurrentIndex(mainFrameRateIndex >= 0 ? mainFrameRateIndex : 0);
+	ui->mainOutputAlpha->setChecked(config->OutputAlpha);
+	auto audioFrameSamplesIndex = ui->mainOutputAudioFrameSamples->findData(config->OutputAudioFrameSamples);
+	ui->mainOutputAudioFrameSamples->setCurrentIndex(audioFrameSamplesIndex >= 0 ? audioFrameSamplesIndex : 0);
+	ui->mainOutputIdleKeepalive->setChecked(config->OutputIdleKeepalive);
 
 	auto lastError = main_output_last_error();
 	ui->mainOutputLastError->setText(lastError);
@@ -366,9 +526,28 @@ void OutputSettings::showEvent(QShowEvent *)
 		ui->mainOutputLastError->setFixedHeight(ui->mainOutputLastError->sizeHint().height());
 	}
 
+	bool onProgram = false, onPreview = false;
+	main_output_get_tally(&onProgram, &onPreview);
+	ui->mainOutputTally->setText(obs_module_text(onProgram   ? "NDIPlugin.Downstream.Program"
+						     : onPreview ? "NDIPlugin.Downstream.Preview"
+								 : "NDIPlugin.Downstream.None"));
+
 	ui->previewOutputGroupBox->setChecked(config->PreviewOutputEnabled);
 	ui->previewOutputName->setText(config->PreviewOutputName);
 	ui->previewOutputGroups->setText(config->PreviewOutputGroups);
+	auto resolutionIndex = ui->previewOutputResolution->findData(config->PreviewOutputResolution);
+	ui->previewOutputResolution->setCurrentIndex(resolutionIndex >= 0 ? resolutionIndex : 0);
+	auto frameRateIndex = ui->previewOutputFrameRate->findData(config->PreviewOutputFrameDivisor);
+	ui->previewOutputFrameRate->setCurrentIndex(frameRateIndex >= 0 ? frameRateIndex : 0);
+
+	preview_output_get_tally(&onProgram, &onPreview);
+	ui->previewOutputTally->setText(obs_module_text(onProgram   ? "NDIPlugin.Downstream.Program"
+							: onPreview ? "NDIPlugin.Downstream.Preview"
+								    : "NDIPlugin.Downstream.None"));
+
+	ui->auxOutputsTable->setRowCount(0);
+	for (const auto &auxOutput : config->AuxOutputs)
+		addAuxOutputRow(auxOutput);
 
 	ui->tallyProgramCheckBox->setChecked(config->TallyProgramEnabled);
 	ui->tallyPreviewCheckBox->setChecked(config->TallyPreviewEnabled);
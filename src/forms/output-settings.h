@@ -19,6 +19,8 @@
 
 #include "ui_output-settings.h"
 
+#include "config.h"
+
 class OutputSettings : public QDialog {
 	Q_OBJECT
 public:
@@ -30,5 +32,11 @@ private slots:
 	void onFormAccepted();
 
 private:
+	void addAuxOutputRow(const AuxOutput &auxOutput);
+	QList<AuxOutput> auxOutputsFromTable();
+
+	// Whether the OBS canvas format can be sent by the main output, checked when the dialog is shown
+	bool canvasSupported = false;
+
 	std::unique_ptr<Ui::OutputSettings> ui;
 };
@@ -18,6 +18,7 @@
 #include "main-output.h"
 
 #include "plugin-main.h"
+#include <atomic>
 #include <random>
 
 struct main_output {
@@ -30,11 +31,27 @@ struct main_output {
 
 static struct main_output context = {0};
 
+// Set from the output's sender monitor thread
+static std::atomic<bool> tally_on_program{false};
+static std::atomic<bool> tally_on_preview{false};
+
 QString main_output_last_error()
 {
 	return context.last_error;
 };
 
+void main_output_get_tally(bool *on_program, bool *on_preview)
+{
+	*on_program = tally_on_program.load();
+	*on_preview = tally_on_preview.load();
+}
+
+void on_main_output_tally(void *, calldata_t *cd)
+{
+	tally_on_program.store(calldata_bool(cd, "on_program"));
+	tally_on_preview.store(calldata_bool(cd, "on_preview"));
+}
+
 void on_main_output_started(void *, calldata_t *)
 {
 	obs_log(LOG_DEBUG, "+on_main_output_started()");
@@ -141,6 +158,10 @@ void main_output_deinit()
 					  on_main_output_started, nullptr);
 		signal_handler_disconnect(sh, "stop", //
 					  on_main_output_stopped, nullptr);
+		signal_handler_disconnect(sh, "ndi_tally", //
+					  on_main_output_tally, nullptr);
+		tally_on_program.store(false);
+		tally_on_preview.store(false);
 
 		obs_output_release(context.output);
 		context.output = nullptr;
@@ -161,7 +182,8 @@ void main_output_init()
 	auto output_groups = config->OutputGroups;
 	auto is_enabled = config->OutputEnabled;
 
-	if (is_enabled && !main_output_is_supported()) {
+	// With alpha the program is rendered by DistroAV, so the canvas color format does not matter
+	if (is_enabled && !config->OutputAlpha && !main_output_is_supported()) {
 		is_enabled = false;
 		obs_log(LOG_WARNING, "WARN-426 - NDI Main Output disabled, format not supported");
 	}
@@ -173,8 +195,14 @@ void main_output_init()
 		obs_data_t *output_settings = obs_data_create();
 		obs_data_set_string(output_settings, "ndi_name", QT_TO_UTF8(output_name));
 		obs_data_set_string(output_settings, "ndi_groups", QT_TO_UTF8(output_groups));
-
-		context.output = obs_output_create("ndi_output", "NDI Main Output", output_settings, nullptr);
+		obs_data_set_int(output_settings, "pacing", config->OutputPacing);
+		obs_data_set_int(output_settings, "frame_divisor", config->OutputFrameDivisor);
+		obs_data_set_int(output_settings, "audio_frame_samples", config->OutputAudioFrameSamples);
+		obs_data_set_bool(output_settings, "idle_keepalive", config->OutputIdleKeepalive);
+
+		// The alpha output renders the program itself and only takes the audio from OBS
+		context.output = obs_output_create(config->OutputAlpha ? "ndi_alpha_output" : "ndi_output",
+						   "NDI Main Output", output_settings, nullptr);
 		obs_data_release(output_settings);
 		if (context.output) {
 			obs_log(LOG_DEBUG, "main_output_init: created NDI Main Output '%s'", QT_TO_UTF8(output_name));
@@ -185,6 +213,8 @@ void main_output_init()
 				sh, "start", on_main_output_started, nullptr);
 			signal_handler_connect( //
 				sh, "stop", on_main_output_stopped, nullptr);
+			signal_handler_connect( //
+				sh, "ndi_tally", on_main_output_tally, nullptr);
 
 			context.ndi_name = output_name;
 			context.ndi_groups = output_groups;
@@ -20,4 +20,6 @@
 void main_output_deinit();
 void main_output_init();
 QString main_output_last_error();
+// Downstream tally of the main output, false for both while it is not running
+void main_output_get_tally(bool *on_program, bool *on_preview);
 bool main_output_is_supported();
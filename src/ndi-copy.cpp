@@ -0,0 +1,86 @@
+/******************************************************************************
+	Copyright (C) 2016-2024 DistroAV <contact@distroav.org>
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation; either version 2
+	of the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, see <https://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "ndi-copy.h"
+
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NDI_COPY_STREAMING 1
+#endif
+
+// Below this frame size the destination is likely to still be in cache when it is read again
+#define NDI_COPY_STREAMING_MIN_BYTES (512 * 1024)
+
+#ifdef NDI_COPY_STREAMING
+static void ndi_copy_rows_streaming(uint8_t *dst, uint32_t dst_linesize, const uint8_t *src,
+				    uint32_t src_linesize, uint32_t row_bytes, uint32_t rows)
+{
+	for (uint32_t y = 0; y < rows; ++y) {
+		uint8_t *d = dst + (size_t)y * dst_linesize;
+		const uint8_t *s = src + (size_t)y * src_linesize;
+		size_t remaining = row_bytes;
+
+		// Streaming stores need a 16-byte aligned destination, the source can be unaligned
+		size_t head = (16 - ((uintptr_t)d & 15)) & 15;
+		if (head > remaining)
+			head = remaining;
+		memcpy(d, s, head);
+		d += head;
+		s += head;
+		remaining -= head;
+
+		for (; remaining >= 64; remaining -= 64, d += 64, s += 64) {
+			__m128i a = _mm_loadu_si128((const __m128i *)s);
+			__m128i b = _mm_loadu_si128((const __m128i *)(s + 16));
+			__m128i c = _mm_loadu_si128((const __m128i *)(s + 32));
+			__m128i e = _mm_loadu_si128((const __m128i *)(s + 48));
+			_mm_stream_si128((__m128i *)d, a);
+			_mm_stream_si128((__m128i *)(d + 16), b);
+			_mm_stream_si128((__m128i *)(d + 32), c);
+			_mm_stream_si128((__m128i *)(d + 48), e);
+		}
+		for (; remaining >= 16; remaining -= 16, d += 16, s += 16)
+			_mm_stream_si128((__m128i *)d, _mm_loadu_si128((const __m128i *)s));
+
+		memcpy(d, s, remaining);
+	}
+
+	// Make the streamed data visible to the thread that consumes the frame
+	_mm_sfence();
+}
+#endif
+
+void ndi_copy_plane(uint8_t *dst, uint32_t dst_linesize, const uint8_t *src, uint32_t src_linesize,
+		    uint32_t row_bytes, uint32_t rows)
+{
+	if (src_linesize == row_bytes && dst_linesize == row_bytes) {
+		memcpy(dst, src, (size_t)row_bytes * rows);
+		return;
+	}
+
+#ifdef NDI_COPY_STREAMING
+	if ((size_t)row_bytes * rows >= NDI_COPY_STREAMING_MIN_BYTES) {
+		ndi_copy_rows_streaming(dst, dst_linesize, src, src_linesize, row_bytes, rows);
+		return;
+	}
+#endif
+
+	for (uint32_t y = 0; y < rows; ++y)
+		memcpy(dst + (size_t)y * dst_linesize, src + (size_t)y * src_linesize, row_bytes);
+}
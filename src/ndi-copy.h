@@ -0,0 +1,28 @@
+/******************************************************************************
+	Copyright (C) 2016-2024 DistroAV <contact@distroav.org>
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation; either version 2
+	of the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, see <https://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Copies `rows` rows of `row_bytes` bytes from `src` to `dst`, whose rows are `src_linesize` and
+// `dst_linesize` bytes apart. Planes with no row padding on either side are copied in one go;
+// padded planes are copied row by row, with non-temporal stores for frames too large to benefit
+// from being left in the cache (on SSE2 capable CPUs).
+void ndi_copy_plane(uint8_t *dst, uint32_t dst_linesize, const uint8_t *src, uint32_t src_linesize,
+		    uint32_t row_bytes, uint32_t rows);
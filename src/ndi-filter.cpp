@@ -17,21 +17,51 @@
 
 #include "plugin-main.h"
 #include "sync-debug.h"
+#include "ndi-sender-registry.h"
+#include "ndi-sender-monitor.h"
+#include "ndi-send-queue.h"
+#include "ndi-readback-cache.h"
 #include <util/platform.h>
 #include <util/threading.h>
-#include <media-io/video-frame.h>
 
 #include <QDesktopServices>
 #include <QUrl>
 
-#define TEXFORMAT GS_BGRA
+#include <algorithm>
+
 #define FLT_PROP_NAME "ndi_filter_ndiname"
 #define FLT_PROP_GROUPS "ndi_filter_ndigroups"
+#define FLT_PROP_PIXEL_FORMAT "ndi_filter_pixelformat"
+#define FLT_PROP_FRAME_DIVISOR "ndi_filter_framedivisor"
+#define FLT_PROP_SIZE_MODE "ndi_filter_sizemode"
+#define FLT_PROP_WIDTH "ndi_filter_width"
+#define FLT_PROP_HEIGHT "ndi_filter_height"
+#define FLT_PROP_ONLY_CONNECTED "ndi_filter_onlyconnected"
+#define FLT_PROP_OBS_TIMECODES "ndi_filter_obstimecodes"
+#define FLT_PROP_TALLY "ndi_filter_tally"
+#define FLT_PROP_STATS "ndi_filter_stats"
+
+typedef enum ndi_filter_size_mode {
+	FILTER_SIZE_NATIVE = 0, // size of the filtered source
+	FILTER_SIZE_FIXED = 1,  // exactly the configured size, stretched
+	FILTER_SIZE_FIT = 2,    // scaled down to fit within the configured size, keeping the aspect ratio
+} ndi_filter_size_mode_t;
+
+#define FILTER_SIZE_MAX 8192
 
 typedef struct {
 	obs_source_t *obs_source;
 
 	NDIlib_send_instance_t ndi_sender;
+	// Resolved NDI name and groups ndi_sender was created with (graphics/UI thread only)
+	char *ndi_sender_name;
+	char *ndi_sender_groups;
+	// Downstream tally of ndi_sender, changes are forwarded as the source's "ndi_tally" signal
+	ndi_sender_monitor_t *ndi_sender_monitor;
+	// Set by tally changes, the properties showing the downstream indicator are then reloaded
+	// from the tick, at most once per FILTER_PROPERTIES_REFRESH_INTERVAL_NS
+	volatile long tally_changed;
+	uint64_t last_properties_refresh_ns;
 
 	pthread_mutex_t ndi_sender_video_mutex;
 	pthread_mutex_t ndi_sender_audio_mutex;
@@ -43,23 +73,47 @@ typedef struct {
 	uint32_t known_height;
 	bool rendered;
 
-	gs_texrender_t *texrender;
-	gs_stagesurf_t *stagesurface;
-	uint8_t *video_data;
-	uint32_t video_linesize;
-#ifdef SYNC_DEBUG
+	// Shared with the other filters sending the same pixels (graphics thread only)
+	ndi_readback_cache_entry_t *readback;
+	// Requested pixel format, and the one the current send queue was created for
+	ndi_pixel_format_t pixel_format;
+	ndi_pixel_format_t known_format;
+	// Size the source is rendered at on the GPU, before the readback
+	ndi_filter_size_mode_t size_mode;
+	uint32_t size_width;
+	uint32_t size_height;
+	// Only every Nth frame is rendered, read back and sent
+	uint32_t frame_divisor;
+	// Divisor the send queue's video rate was set for (ndi_sender_video_mutex)
+	uint32_t send_queue_frame_divisor;
+	uint64_t frame_count;
+	// Without receivers only a keepalive frame per second is rendered, read back and sent
+	bool only_connected;
+	uint64_t last_video_sent_ns;
+	// Stamp audio and video with their OBS timestamps instead of letting NDI synthesize timecodes
+	bool obs_timecodes;
 	// Time offset to apply to OBS timestamps to synchronize with NDI timestamps
 	uint64_t obs_to_ndi_time_offset;
-#endif
-	video_t *video_output;
+	// Moving average of the time from capture to the NDI send call of audio, published by the
+	// audio thread in microseconds, compared to the video one to report the A/V offset
+	volatile long audio_latency_us;
+	uint64_t last_av_offset_report_ns; // protected by ndi_sender_video_mutex
 	bool is_audioonly;
 
+	// Frames are read back straight into the slots of the send queue, whose thread does the
+	// NDI video sends. Created for the current sender and frame layout on the graphics thread,
+	// destroyed whenever either changes. Protected by ndi_sender_video_mutex.
+	ndi_send_queue_t *ndi_send_queue;
+	ndi_video_slot_t *video_slot; // acquired but not pushed yet
+
+	// Audio thread only
+	size_t audio_channels; // from oai.speakers
 	uint8_t *audio_conv_buffer;
 	size_t audio_conv_buffer_size;
-	int32_t no_video_connections;
-	std::chrono::time_point<std::chrono::steady_clock> last_video_conn_check;
-	int32_t no_audio_connections;
-	std::chrono::time_point<std::chrono::steady_clock> last_audio_conn_check;
+	uint64_t audio_stats_callbacks;
+	uint64_t audio_stats_direct;
+	uint64_t audio_stats_ns;
+	uint64_t audio_latency_avg_ns;
 } ndi_filter_t;
 
 const char *ndi_filter_getname(void *)
@@ -72,14 +126,25 @@ const char *ndi_audiofilter_getname(void *)
 	return obs_module_text("NDIPlugin.AudioFilterName");
 }
 
-#ifdef SYNC_DEBUG
 uint64_t now_ns()
 {
 	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
 					     std::chrono::system_clock::now().time_since_epoch())
 					     .count());
 }
-#endif
+
+// Sources that do not timestamp their audio with the OBS clock are sent with synthesized timecodes
+#define OBS_CLOCK_MAX_SKEW_NS 5000000000ULL
+// Interval of the A/V offset debug log
+#define AV_OFFSET_REPORT_INTERVAL_NS 10000000000ULL
+
+// NDI timecode (100 ns units, UTC based) for a frame captured at `timestamp` on the OBS clock
+static int64_t ndi_filter_timecode(const ndi_filter_t *f, uint64_t timestamp)
+{
+	if (!f->obs_timecodes || !timestamp)
+		return NDIlib_send_timecode_synthesize;
+	return (int64_t)((timestamp + f->obs_to_ndi_time_offset) / 100);
+}
 
 void ndi_filter_update(void *data, obs_data_t *settings);
 void ndi_sender_destroy(ndi_filter_t *filter);
@@ -97,6 +162,42 @@ void on_renamed(void *data, calldata_t *)
 	ndi_sender_create(f, nullptr);
 }
 
+// Called from the sender monitor thread when a receiver puts the filter's output on program or preview
+static void on_ndi_tally(void *data, bool on_program, bool on_preview)
+{
+	auto f = (ndi_filter_t *)data;
+
+	struct calldata cd;
+	uint8_t stack[128];
+	calldata_init_fixed(&cd, stack, sizeof(stack));
+	calldata_set_ptr(&cd, "source", f->obs_source);
+	calldata_set_bool(&cd, "on_program", on_program);
+	calldata_set_bool(&cd, "on_preview", on_preview);
+	signal_handler_signal(obs_source_get_signal_handler(f->obs_source), "ndi_tally", &cd);
+
+	os_atomic_set_long(&f->tally_changed, 1);
+}
+
+// Longest a tally change waits to be shown in open properties, and shortest time between two reloads
+#define FILTER_PROPERTIES_REFRESH_INTERVAL_NS 2000000000ULL
+
+// Reloads open properties for the downstream indicator. Tally changes in a burst (e.g. a switcher
+// cutting back and forth) are coalesced into a single reload, so a dialog being edited is not
+// rebuilt over and over.
+static void ndi_filter_refresh_tally(ndi_filter_t *f)
+{
+	if (!os_atomic_load_long(&f->tally_changed))
+		return;
+
+	uint64_t now = os_gettime_ns();
+	if (now - f->last_properties_refresh_ns < FILTER_PROPERTIES_REFRESH_INTERVAL_NS)
+		return;
+
+	os_atomic_set_long(&f->tally_changed, 0);
+	f->last_properties_refresh_ns = now;
+	obs_source_update_properties(f->obs_source);
+}
+
 static void ndi_filter_disconnect_rename_handlers(ndi_filter_t *filter)
 {
 	if (!filter || !filter->obs_source) {
@@ -117,8 +218,9 @@ static void ndi_filter_disconnect_rename_handlers(ndi_filter_t *filter)
 	}
 }
 
-obs_properties_t *ndi_filter_getproperties(void *)
+obs_properties_t *ndi_filter_getproperties(void *data)
 {
+	auto f = (ndi_filter_t *)data;
 	obs_log(LOG_DEBUG, "+ndi_filter_getproperties(...)");
 	obs_properties_t *props = obs_properties_create();
 	obs_properties_set_flags(props, OBS_PROPERTIES_DEFER_UPDATE);
@@ -131,6 +233,93 @@ obs_properties_t *ndi_filter_getproperties(void *)
 	obs_properties_add_text(props, FLT_PROP_GROUPS, obs_module_text("NDIPlugin.FilterProps.NDIGroups"),
 				OBS_TEXT_DEFAULT);
 
+	if (!f || !f->is_audioonly) {
+		obs_property_t *pixel_format = obs_properties_add_list(
+			props, FLT_PROP_PIXEL_FORMAT, obs_module_text("NDIPlugin.FilterProps.PixelFormat"),
+			OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+		obs_property_list_add_int(pixel_format, obs_module_text("NDIPlugin.FilterProps.PixelFormat.UYVA"),
+					  NDI_PIXEL_FORMAT_UYVA);
+		obs_property_list_add_int(pixel_format, obs_module_text("NDIPlugin.FilterProps.PixelFormat.UYVY"),
+					  NDI_PIXEL_FORMAT_UYVY);
+		obs_property_list_add_int(pixel_format, obs_module_text("NDIPlugin.FilterProps.PixelFormat.BGRA"),
+					  NDI_PIXEL_FORMAT_BGRA);
+
+		obs_property_t *size_mode = obs_properties_add_list(props, FLT_PROP_SIZE_MODE,
+								    obs_module_text("NDIPlugin.FilterProps.Size"),
+								    OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+		obs_property_list_add_int(size_mode, obs_module_text("NDIPlugin.FilterProps.Size.Native"),
+					  FILTER_SIZE_NATIVE);
+		obs_property_list_add_int(size_mode, obs_module_text("NDIPlugin.FilterProps.Size.Fixed"),
+					  FILTER_SIZE_FIXED);
+		obs_property_list_add_int(size_mode, obs_module_text("NDIPlugin.FilterProps.Size.Fit"),
+					  FILTER_SIZE_FIT);
+		obs_property_set_modified_callback(size_mode, [](obs_properties_t *props_, obs_property_t *,
+								 obs_data_t *settings_) {
+			bool is_native = (obs_data_get_int(settings_, FLT_PROP_SIZE_MODE) == FILTER_SIZE_NATIVE);
+
+			obs_property_set_visible(obs_properties_get(props_, FLT_PROP_WIDTH), !is_native);
+			obs_property_set_visible(obs_properties_get(props_, FLT_PROP_HEIGHT), !is_native);
+
+			return true;
+		});
+		obs_properties_add_int(props, FLT_PROP_WIDTH, obs_module_text("NDIPlugin.FilterProps.Width"), 2,
+				       FILTER_SIZE_MAX, 2);
+		obs_properties_add_int(props, FLT_PROP_HEIGHT, obs_module_text("NDIPlugin.FilterProps.Height"), 1,
+				       FILTER_SIZE_MAX, 1);
+
+		obs_property_t *frame_divisor = obs_properties_add_list(
+			props, FLT_PROP_FRAME_DIVISOR, obs_module_text("NDIPlugin.FilterProps.FrameRate"),
+			OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+		obs_property_list_add_int(frame_divisor, obs_module_text("NDIPlugin.FrameRate.Canvas"), 1);
+		obs_property_list_add_int(frame_divisor, obs_module_text("NDIPlugin.FrameRate.Half"), 2);
+		obs_property_list_add_int(frame_divisor, obs_module_text("NDIPlugin.FrameRate.Third"), 3);
+		obs_property_list_add_int(frame_divisor, obs_module_text("NDIPlugin.FrameRate.Quarter"), 4);
+
+		obs_property_t *only_connected = obs_properties_add_bool(
+			props, FLT_PROP_ONLY_CONNECTED, obs_module_text("NDIPlugin.FilterProps.OnlyConnected"));
+		obs_property_set_long_description(only_connected,
+						  obs_module_text("NDIPlugin.FilterProps.OnlyConnected.Description"));
+	}
+
+	obs_property_t *obs_timecodes = obs_properties_add_bool(
+		props, FLT_PROP_OBS_TIMECODES, obs_module_text("NDIPlugin.FilterProps.OBSTimecodes"));
+	obs_property_set_long_description(obs_timecodes,
+					  obs_module_text("NDIPlugin.FilterProps.OBSTimecodes.Description"));
+
+	if (f) {
+		bool on_program = false, on_preview = false;
+		pthread_mutex_lock(&f->ndi_sender_audio_mutex);
+		ndi_sender_monitor_get_tally(f->ndi_sender_monitor, &on_program, &on_preview);
+		pthread_mutex_unlock(&f->ndi_sender_audio_mutex);
+		auto tally = on_program   ? "NDIPlugin.Downstream.Program"
+			     : on_preview ? "NDIPlugin.Downstream.Preview"
+					  : "NDIPlugin.Downstream.None";
+		obs_properties_add_text(props, FLT_PROP_TALLY, obs_module_text(tally), OBS_TEXT_INFO);
+	}
+
+	// A snapshot taken when the properties are built: reloading them periodically to keep the
+	// values current would rebuild the dialog while it is being edited
+	if (f && !f->is_audioonly) {
+		ndi_send_queue_stats_t queue_stats;
+		pthread_mutex_lock(&f->ndi_sender_video_mutex);
+		ndi_send_queue_get_stats(f->ndi_send_queue, &queue_stats);
+		pthread_mutex_unlock(&f->ndi_sender_video_mutex);
+		auto stats = QString(obs_module_text("NDIPlugin.FilterProps.Stats"))
+				     .arg(queue_stats.video_send_avg_ns / 1000000.0, 0, 'f', 1)
+				     .arg(queue_stats.video_send_max_ns / 1000000.0, 0, 'f', 1)
+				     .arg((long long)queue_stats.video_dropped);
+		long audio_latency_us = os_atomic_load_long(&f->audio_latency_us);
+		if (audio_latency_us && queue_stats.video_latency_avg_ns) {
+			double audio_ms = audio_latency_us / 1000.0;
+			double video_ms = queue_stats.video_latency_avg_ns / 1000000.0;
+			stats += "\n" + QString(obs_module_text("NDIPlugin.FilterProps.AVOffset"))
+						 .arg(video_ms - audio_ms, 0, 'f', 1)
+						 .arg(audio_ms, 0, 'f', 1)
+						 .arg(video_ms, 0, 'f', 1);
+		}
+		obs_properties_add_text(props, FLT_PROP_STATS, stats.toUtf8().constData(), OBS_TEXT_INFO);
+	}
+
 	obs_properties_add_button(props, "ndi_apply", obs_module_text("NDIPlugin.FilterProps.ApplySettings"),
 				  [](obs_properties_t *, obs_property_t *, void *private_data) {
 					  auto s = (ndi_filter_t *)private_data;
@@ -149,6 +338,13 @@ void ndi_filter_getdefaults(obs_data_t *defaults)
 	obs_log(LOG_DEBUG, "+ndi_filter_getdefaults(...)");
 	obs_data_set_default_string(defaults, FLT_PROP_NAME, obs_module_text("NDIPlugin.FilterProps.NDIName.Default"));
 	obs_data_set_default_string(defaults, FLT_PROP_GROUPS, "");
+	obs_data_set_default_int(defaults, FLT_PROP_PIXEL_FORMAT, NDI_PIXEL_FORMAT_UYVA);
+	obs_data_set_default_int(defaults, FLT_PROP_SIZE_MODE, FILTER_SIZE_NATIVE);
+	obs_data_set_default_int(defaults, FLT_PROP_WIDTH, 1920);
+	obs_data_set_default_int(defaults, FLT_PROP_HEIGHT, 1080);
+	obs_data_set_default_int(defaults, FLT_PROP_FRAME_DIVISOR, 1);
+	obs_data_set_default_bool(defaults, FLT_PROP_ONLY_CONNECTED, true);
+	obs_data_set_default_bool(defaults, FLT_PROP_OBS_TIMECODES, false);
 	obs_log(LOG_DEBUG, "-ndi_filter_getdefaults(...)");
 }
 
@@ -170,61 +366,154 @@ bool is_filter_valid(ndi_filter_t *filter)
 	return is_valid;
 }
 
-void ndi_filter_raw_video(void *data, video_data *frame)
+// Frames waiting for the sender thread; older ones are dropped when NDI falls behind
+#define FILTER_VIDEO_QUEUE_DEPTH 2
+// With `only_connected` and no receivers, one frame is still sent this often so that
+// receivers browsing for sources get a thumbnail
+#define FILTER_KEEPALIVE_INTERVAL_NS 1000000000ULL
+
+// Must be called with ndi_sender_video_mutex held. Sends what is still queued.
+static void ndi_filter_destroy_send_queue(ndi_filter_t *f)
+{
+	// A slot that was acquired but not pushed is freed with the queue
+	f->video_slot = nullptr;
+	ndi_send_queue_destroy(f->ndi_send_queue);
+	f->ndi_send_queue = nullptr;
+}
+
+// Must be called with ndi_sender_video_mutex held
+static bool ndi_filter_ensure_send_queue(ndi_filter_t *f)
 {
-	auto f = (ndi_filter_t *)data;
+	uint32_t frame_divisor = f->frame_divisor;
+	if (f->ndi_send_queue && f->send_queue_frame_divisor == frame_divisor)
+		return true;
+	// Jitter, latency and pacing are measured against the frame interval: a new rate needs a new queue
+	ndi_filter_destroy_send_queue(f);
+	if (!f->ndi_sender)
+		return false;
+
+	f->ndi_send_queue = ndi_send_queue_create(
+		f->ndi_sender, obs_source_get_name(f->obs_source),
+		ndi_readback_frame_size(f->known_format, f->known_width, f->known_height), FILTER_VIDEO_QUEUE_DEPTH, 0,
+		0);
+	ndi_send_queue_set_video_rate(f->ndi_send_queue, f->ovi.fps_num, f->ovi.fps_den * frame_divisor,
+				      NDI_SEND_PACING_NONE);
+	f->send_queue_frame_divisor = frame_divisor;
+	return f->ndi_send_queue != nullptr;
+}
 
+// Sends an empty frame to tell receivers that the filter has nothing to show
+static void ndi_filter_send_empty_frame(ndi_filter_t *f)
+{
 	pthread_mutex_lock(&f->ndi_sender_video_mutex);
+	// Waits for NDI to release the queued frames before sending synchronously on the same sender
+	ndi_filter_destroy_send_queue(f);
+	if (f->ndi_sender) {
+		NDIlib_video_frame_v2_t video_frame = {0};
+		ndiLib->send_send_video_v2(f->ndi_sender, &video_frame);
+	}
+	pthread_mutex_unlock(&f->ndi_sender_video_mutex);
+}
 
-	if (!f->ndi_sender) {
-		pthread_mutex_unlock(&f->ndi_sender_video_mutex);
+// NDI filters pass their input through unchanged: filters stacked directly on top of each
+// other send the same pixels, those of the first source below them that is not an NDI filter.
+static obs_source_t *ndi_filter_get_content(ndi_filter_t *f)
+{
+	obs_source_t *parent = obs_filter_get_parent(f->obs_source);
+	obs_source_t *content = obs_filter_get_target(f->obs_source);
+	while (content && content != parent && strcmp(obs_source_get_id(content), "ndi_filter") == 0)
+		content = obs_filter_get_target(content);
+	return content;
+}
+
+// Size the filtered source (`source_width` x `source_height`) is sent at
+static void ndi_filter_output_size(const ndi_filter_t *f, uint32_t source_width, uint32_t source_height,
+				   uint32_t *width, uint32_t *height)
+{
+	*width = source_width;
+	*height = source_height;
+
+	if (f->size_mode == FILTER_SIZE_FIXED) {
+		*width = f->size_width;
+		*height = f->size_height;
+	} else if (f->size_mode == FILTER_SIZE_FIT) {
+		double scale = std::min({(double)f->size_width / source_width, (double)f->size_height / source_height,
+					 1.0});
+		if (scale >= 1.0)
+			return;
+		*width = (uint32_t)(source_width * scale + 0.5);
+		*height = (uint32_t)(source_height * scale + 0.5);
+	} else {
 		return;
 	}
 
-	auto now = std::chrono::steady_clock::now();
-	if (now - f->last_video_conn_check >= std::chrono::seconds(1)) {
-		f->last_video_conn_check = now;
-		int nc = ndiLib->send_get_no_connections(f->ndi_sender, 10);
-		if (nc != f->no_video_connections) {
-			auto ndi_source = ndiLib->send_get_source_name(f->ndi_sender);
-			if (nc <= 0)
-				obs_log(LOG_DEBUG, "Dedicated NDI Output video '%s' has no connections",
-					ndi_source->p_ndi_name);
-			else if (f->no_video_connections == 0)
-				obs_log(LOG_DEBUG, "Dedicated NDI Output video '%s' has %d connections",
-					ndi_source->p_ndi_name, nc);
-			f->no_video_connections = nc;
-		}
+	// Scaled sizes are kept even, so that the packed 4:2:2 formats remain available
+	*width = std::max<uint32_t>(*width & ~1u, 2);
+	*height = std::max<uint32_t>(*height, 1);
+}
+
+// Downloads the ready frame into a send queue slot
+static void ndi_filter_send_video(ndi_filter_t *f, uint64_t frame_time, uint64_t timestamp)
+{
+	pthread_mutex_lock(&f->ndi_sender_video_mutex);
+
+	if (!ndi_filter_ensure_send_queue(f)) {
+		pthread_mutex_unlock(&f->ndi_sender_video_mutex);
+		return;
 	}
 
-	pthread_mutex_unlock(&f->ndi_sender_video_mutex);
+	// A slot that could not be filled is kept for the next frame, as it cannot be given back
+	if (!f->video_slot)
+		f->video_slot = ndi_send_queue_acquire_video(f->ndi_send_queue);
+	auto slot = f->video_slot;
+	if (!slot) {
+		pthread_mutex_unlock(&f->ndi_sender_video_mutex);
+		return;
+	}
 
-	NDIlib_video_frame_v2_t video_frame = {0};
-
-	// Only fill out the data if we have a valid frame
-	if (frame && frame->data[0]) {
-		video_frame.xres = f->known_width;
-		video_frame.yres = f->known_height;
-		video_frame.FourCC = NDIlib_FourCC_type_BGRA;
-		video_frame.frame_rate_N = f->ovi.fps_num;
-		video_frame.frame_rate_D = f->ovi.fps_den;
-		video_frame.picture_aspect_ratio = 0; // square pixels
-		video_frame.frame_format_type = NDIlib_frame_format_type_progressive;
+	NDIlib_video_frame_v2_t &video_frame = slot->frame;
+	video_frame = {0};
+	video_frame.xres = f->known_width;
+	video_frame.yres = f->known_height;
+	video_frame.FourCC = ndi_readback_fourcc(f->known_format);
+	// Exact rational rate, also when decimated: 1/2 of 60000/1001 is 60000/2002. Same divisor as the queue.
+	video_frame.frame_rate_N = f->ovi.fps_num;
+	video_frame.frame_rate_D = f->ovi.fps_den * f->send_queue_frame_divisor;
+	video_frame.picture_aspect_ratio = 0; // square pixels
+	video_frame.frame_format_type = NDIlib_frame_format_type_progressive;
 #ifdef SYNC_DEBUG
-		// Convert OBS timestamp in nanoseconds to NDI timestamp in 100-nanosecond intervals,
-		// applying offset to synchronize with audio frames
-		video_frame.timestamp = (frame->timestamp + f->obs_to_ndi_time_offset) / 100;
+	// Convert OBS timestamp in nanoseconds to NDI timestamp in 100-nanosecond intervals,
+	// applying offset to synchronize with audio frames
+	video_frame.timestamp = (timestamp + f->obs_to_ndi_time_offset) / 100;
 #endif
-		video_frame.timecode = NDIlib_send_timecode_synthesize;
-		video_frame.p_data = frame->data[0];
-		video_frame.line_stride_in_bytes = frame->linesize[0];
+	video_frame.timecode = ndi_filter_timecode(f, timestamp);
+	video_frame.p_data = slot->data;
+	video_frame.line_stride_in_bytes = (int)ndi_readback_linesize(f->known_format, f->known_width);
+	slot->capture_ns = timestamp;
+
+	if (ndi_readback_cache_download(f->readback, frame_time, slot->data)) {
+		SYNC_DEBUG_LOG_VIDEO_TIME("NDI <- ndi_filter", obs_source_get_name(f->obs_source),
+					  video_frame.timestamp * 100, (uint8_t *)video_frame.p_data);
+		f->video_slot = nullptr;
+		ndi_send_queue_push_video(f->ndi_send_queue, slot);
+	}
+
+	if (timestamp - f->last_av_offset_report_ns >= AV_OFFSET_REPORT_INTERVAL_NS) {
+		f->last_av_offset_report_ns = timestamp;
+		ndi_send_queue_stats_t stats;
+		ndi_send_queue_get_stats(f->ndi_send_queue, &stats);
+		long audio_latency_us = os_atomic_load_long(&f->audio_latency_us);
+		if (audio_latency_us && stats.video_latency_avg_ns) {
+			obs_log(LOG_DEBUG,
+				"'%s' ndi_filter A/V offset: video sent %.1fms after audio "
+				"(capture to send: audio=%.1fms video=%.1fms, timecodes=%s)",
+				obs_source_get_name(f->obs_source),
+				stats.video_latency_avg_ns / 1000000.0 - audio_latency_us / 1000.0,
+				audio_latency_us / 1000.0, stats.video_latency_avg_ns / 1000000.0,
+				f->obs_timecodes ? "obs" : "synthesized");
+		}
 	}
 
-	pthread_mutex_lock(&f->ndi_sender_video_mutex);
-	SYNC_DEBUG_LOG_VIDEO_TIME("NDI <- ndi_filter", obs_source_get_name(f->obs_source), video_frame.timestamp * 100,
-				  (uint8_t *)video_frame.p_data);
-	if (f->ndi_sender)
-		ndiLib->send_send_video_v2(f->ndi_sender, &video_frame);
 	pthread_mutex_unlock(&f->ndi_sender_video_mutex);
 }
 
@@ -245,44 +534,59 @@ void ndi_filter_render_video(void *data, gs_effect_t *)
 
 	if (!is_filter_valid(f)) {
 		// Send over an empty frame to indicate that the filter is invalid
-		ndi_filter_raw_video(data, nullptr);
+		ndi_filter_send_empty_frame(f);
 		return;
 	}
 
-	uint32_t width = obs_source_get_width(f->obs_source);
-	uint32_t height = obs_source_get_height(f->obs_source);
-
-	if (f->known_width != width || f->known_height != height) {
-		gs_stagesurface_destroy(f->stagesurface);
-		f->stagesurface = gs_stagesurface_create(width, height, TEXFORMAT);
+	// The GPU render, staging and readback are skipped entirely for frames nobody receives
+	int connections = -1;
+	if (f->only_connected) {
+		uint64_t now = os_gettime_ns();
+		pthread_mutex_lock(&f->ndi_sender_video_mutex);
+		connections = ndi_sender_monitor_get_connections(f->ndi_sender_monitor);
+		bool send = ndi_sender_monitor_should_send(f->ndi_sender_monitor, now, &f->last_video_sent_ns,
+							   FILTER_KEEPALIVE_INTERVAL_NS);
+		pthread_mutex_unlock(&f->ndi_sender_video_mutex);
+		if (!send) {
+			f->rendered = true;
+			return;
+		}
+	}
 
-		video_output_info vi = {0};
-		vi.format = VIDEO_FORMAT_BGRA;
-		vi.width = width;
-		vi.height = height;
-		vi.fps_den = f->ovi.fps_den;
-		vi.fps_num = f->ovi.fps_num;
-		vi.cache_size = 16;
-		vi.colorspace = VIDEO_CS_DEFAULT;
-		vi.range = VIDEO_RANGE_DEFAULT;
-		vi.name = obs_source_get_name(f->obs_source);
+	uint32_t source_width = obs_source_get_width(f->obs_source);
+	uint32_t source_height = obs_source_get_height(f->obs_source);
+	uint32_t width, height;
+	ndi_filter_output_size(f, source_width, source_height, &width, &height);
 
-		video_output_close(f->video_output);
-		video_output_open(&f->video_output, &vi);
-		video_output_connect(f->video_output, nullptr, ndi_filter_raw_video, f);
+	obs_source_t *content = ndi_filter_get_content(f);
+	if (!ndi_readback_cache_matches(f->readback, content, width, height, f->pixel_format)) {
+		ndi_readback_cache_release(f->readback);
+		f->readback = ndi_readback_cache_acquire(content, width, height, f->pixel_format,
+							 obs_source_get_name(f->obs_source));
+	}
+	ndi_pixel_format_t format = ndi_readback_cache_format(f->readback);
 
+	if (f->known_width != width || f->known_height != height || f->known_format != format) {
+		// The queue's slots are sized for one layout
+		pthread_mutex_lock(&f->ndi_sender_video_mutex);
+		ndi_filter_destroy_send_queue(f);
 		f->known_width = width;
 		f->known_height = height;
+		f->known_format = format;
+		pthread_mutex_unlock(&f->ndi_sender_video_mutex);
 	}
 
-	gs_texrender_reset(f->texrender);
-
-	if (gs_texrender_begin(f->texrender, width, height)) {
+	// Not rendered again if another filter sending the same pixels already did in this frame
+	uint64_t frame_time = obs_get_video_frame_time();
+	gs_texrender_t *texrender = ndi_readback_cache_begin(f->readback, frame_time);
+	if (texrender && gs_texrender_begin(texrender, width, height)) {
 		vec4 background;
 		vec4_zero(&background);
 
 		gs_clear(GS_CLEAR_COLOR, &background, 0.0f, 0);
-		gs_ortho(0.0f, (float)width, 0.0f, (float)height, -100.0f, 100.0f);
+		// The source is drawn in its own coordinates onto the output size, which scales it on the GPU:
+		// only the scaled pixels are staged, read back and encoded
+		gs_ortho(0.0f, (float)source_width, 0.0f, (float)source_height, -100.0f, 100.0f);
 
 		gs_blend_state_push();
 		gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
@@ -294,26 +598,18 @@ void ndi_filter_render_video(void *data, gs_effect_t *)
 		}
 
 		gs_blend_state_pop();
-		gs_texrender_end(f->texrender);
-
-		gs_stage_texture(f->stagesurface, gs_texrender_get_texture(f->texrender));
-		if (gs_stagesurface_map(f->stagesurface, &f->video_data, &f->video_linesize)) {
-			video_frame output_frame;
-			if (video_output_lock_frame(f->video_output, &output_frame, 1, os_gettime_ns())) {
-				uint32_t linesize = output_frame.linesize[0];
-				for (uint32_t i = 0; i < f->known_height; ++i) {
-					uint32_t dst_offset = linesize * i;
-					uint32_t src_offset = f->video_linesize * i;
-					memcpy(output_frame.data[0] + dst_offset, f->video_data + src_offset, linesize);
-				}
-
-				video_output_unlock_frame(f->video_output);
-			}
-
-			gs_stagesurface_unmap(f->stagesurface);
-		}
+		gs_texrender_end(texrender);
+
+		// Stamped with the video frame time, the OBS clock audio timestamps are on too.
+		// A keepalive frame is read back right away, the next one is a second away.
+		ndi_readback_cache_stage(f->readback, frame_time, connections == 0);
 	}
 
+	// Ready frames always have the current layout: a size or format change uses another entry
+	uint64_t timestamp;
+	if (ndi_readback_cache_ready(f->readback, frame_time, &timestamp))
+		ndi_filter_send_video(f, frame_time, timestamp);
+
 	f->rendered = true;
 }
 
@@ -328,13 +624,29 @@ void ndi_sender_destroy(ndi_filter_t *filter)
 	}
 
 	pthread_mutex_lock(&filter->ndi_sender_audio_mutex);
-	ndiLib->send_destroy(filter->ndi_sender);
+	auto sender = filter->ndi_sender;
+	auto monitor = filter->ndi_sender_monitor;
 	filter->ndi_sender = nullptr;
+	filter->ndi_sender_monitor = nullptr;
+	// The queue sends through the sender, and NDI must be done with its slots before they are freed
+	if (!filter->is_audioonly)
+		ndi_filter_destroy_send_queue(filter);
 	pthread_mutex_unlock(&filter->ndi_sender_audio_mutex);
 
 	if (!filter->is_audioonly) {
 		pthread_mutex_unlock(&filter->ndi_sender_video_mutex);
 	}
+
+	// Nothing sends through them anymore: stopping the monitor (which waits for its thread) and
+	// destroying the sender do not hold up the render and audio threads.
+	// The monitor is stopped before its sender can be destroyed.
+	ndi_sender_monitor_destroy(monitor);
+	ndi_sender_registry_release(sender, filter);
+
+	bfree(filter->ndi_sender_name);
+	bfree(filter->ndi_sender_groups);
+	filter->ndi_sender_name = nullptr;
+	filter->ndi_sender_groups = nullptr;
 }
 
 extern void replace_invalid_filename_chars(QString *s); // defined in forms/output-settings.cpp
@@ -405,21 +717,45 @@ void ndi_sender_create(ndi_filter_t *filter, obs_data_t *settings)
 	send_desc.p_ndi_name = ndi_name_utf8.constData();
 
 	auto groups = obs_data_get_string(settings, FLT_PROP_GROUPS);
+	if (!groups)
+		groups = "";
+
+	// Settings edits and renames that do not change what receivers see (e.g. the pixel format,
+	// or a rename of a source that is not part of the name) keep the sender, its send queue and
+	// its receivers: only the name and groups require a new sender.
+	if (filter->ndi_sender && filter->ndi_sender_name && filter->ndi_sender_groups &&
+	    strcmp(filter->ndi_sender_name, send_desc.p_ndi_name) == 0 &&
+	    strcmp(filter->ndi_sender_groups, groups) == 0) {
+		obs_log(LOG_DEBUG, "'%s' ndi_sender_create: name and groups unchanged, keeping the sender",
+			send_desc.p_ndi_name);
+		if (allocating_settings)
+			obs_data_release(settings);
+		return;
+	}
 
-	if (groups && groups[0])
-		send_desc.p_groups = groups;
-	else
-		send_desc.p_groups = nullptr;
+	send_desc.p_groups = groups[0] ? groups : nullptr;
 	send_desc.clock_video = false;
 	send_desc.clock_audio = false;
 
+	// The new sender is ready before the previous one is swapped out, so the render and audio
+	// threads go on sending without a gap: they only wait for the pointers to be swapped.
+	NDIlib_send_instance_t sender =
+		ndi_sender_registry_acquire(&send_desc, filter, obs_source_get_name(filter->obs_source));
+	ndi_sender_monitor_t *monitor = ndi_sender_monitor_create(sender, send_desc.p_ndi_name);
+	ndi_sender_monitor_set_tally_callback(monitor, on_ndi_tally, filter);
+
 	if (!filter->is_audioonly) {
 		pthread_mutex_lock(&filter->ndi_sender_video_mutex);
 	}
 
 	pthread_mutex_lock(&filter->ndi_sender_audio_mutex);
-	ndiLib->send_destroy(filter->ndi_sender);
-	filter->ndi_sender = ndiLib->send_create(&send_desc);
+	NDIlib_send_instance_t previous_sender = filter->ndi_sender;
+	ndi_sender_monitor_t *previous_monitor = filter->ndi_sender_monitor;
+	filter->ndi_sender = sender;
+	filter->ndi_sender_monitor = monitor;
+	// Recreated for the new sender on the next frame
+	if (!filter->is_audioonly)
+		ndi_filter_destroy_send_queue(filter);
 
 	if (filter->ndi_sender) {
 		obs_log(LOG_INFO, "Dedicated NDI Output sender created: '%s'", send_desc.p_ndi_name);
@@ -430,12 +766,8 @@ void ndi_sender_create(ndi_filter_t *filter, obs_data_t *settings)
 		obs_log(LOG_DEBUG, "'%s' ndi_sender_create: ndi sender init failed", send_desc.p_ndi_name);
 	}
 
-	filter->no_audio_connections = -1;
-
-#ifdef SYNC_DEBUG
-	// Video timestamps are in OBS time, so calculate offset to convert to NDI timestamps
+	// OBS timestamps are on the monotonic clock, NDI timecodes are UTC based
 	filter->obs_to_ndi_time_offset = now_ns() - os_gettime_ns();
-#endif
 
 	pthread_mutex_unlock(&filter->ndi_sender_audio_mutex);
 
@@ -443,6 +775,15 @@ void ndi_sender_create(ndi_filter_t *filter, obs_data_t *settings)
 		pthread_mutex_unlock(&filter->ndi_sender_video_mutex);
 	}
 
+	// Outside the locks, see ndi_sender_destroy
+	ndi_sender_monitor_destroy(previous_monitor);
+	ndi_sender_registry_release(previous_sender, filter);
+
+	bfree(filter->ndi_sender_name);
+	bfree(filter->ndi_sender_groups);
+	filter->ndi_sender_name = sender ? bstrdup(ndi_name_utf8.constData()) : nullptr;
+	filter->ndi_sender_groups = sender ? bstrdup(groups) : nullptr;
+
 	if (allocating_settings) {
 		obs_data_release(settings);
 	}
@@ -457,6 +798,16 @@ void ndi_filter_update(void *data, obs_data_t *settings)
 
 	ndi_sender_create(f, settings);
 
+	// Applied by the next render
+	f->pixel_format = (ndi_pixel_format_t)obs_data_get_int(settings, FLT_PROP_PIXEL_FORMAT);
+	f->size_mode = (ndi_filter_size_mode_t)obs_data_get_int(settings, FLT_PROP_SIZE_MODE);
+	f->size_width = (uint32_t)std::clamp<long long>(obs_data_get_int(settings, FLT_PROP_WIDTH), 2, FILTER_SIZE_MAX);
+	f->size_height = (uint32_t)std::clamp<long long>(obs_data_get_int(settings, FLT_PROP_HEIGHT), 1,
+							 FILTER_SIZE_MAX);
+	f->frame_divisor = (uint32_t)std::max<long long>(obs_data_get_int(settings, FLT_PROP_FRAME_DIVISOR), 1);
+	f->only_connected = obs_data_get_bool(settings, FLT_PROP_ONLY_CONNECTED);
+	f->obs_timecodes = obs_data_get_bool(settings, FLT_PROP_OBS_TIMECODES);
+
 	auto groups = obs_data_get_string(settings, FLT_PROP_GROUPS);
 
 	obs_log(LOG_INFO, "NDI Filter Updated: '%s'", name);
@@ -471,11 +822,13 @@ void *ndi_filter_create(obs_data_t *settings, obs_source_t *obs_source)
 
 	auto f = (ndi_filter_t *)bzalloc(sizeof(ndi_filter_t));
 	f->obs_source = obs_source;
-	f->texrender = gs_texrender_create(TEXFORMAT, GS_ZS_NONE);
 	pthread_mutex_init(&f->ndi_sender_video_mutex, NULL);
 	pthread_mutex_init(&f->ndi_sender_audio_mutex, NULL);
+	signal_handler_add(obs_source_get_signal_handler(obs_source),
+			   "void ndi_tally(ptr source, bool on_program, bool on_preview)");
 	obs_get_video_info(&f->ovi);
 	obs_get_audio_info(&f->oai);
+	f->audio_channels = get_audio_channels(f->oai.speakers);
 
 	ndi_filter_update(f, settings);
 
@@ -495,7 +848,10 @@ void *ndi_filter_create_audioonly(obs_data_t *settings, obs_source_t *obs_source
 	f->is_audioonly = true;
 	f->obs_source = obs_source;
 	pthread_mutex_init(&f->ndi_sender_audio_mutex, NULL);
+	signal_handler_add(obs_source_get_signal_handler(obs_source),
+			   "void ndi_tally(ptr source, bool on_program, bool on_preview)");
 	obs_get_audio_info(&f->oai);
+	f->audio_channels = get_audio_channels(f->oai.speakers);
 
 	ndi_filter_update(f, settings);
 
@@ -513,13 +869,11 @@ void ndi_filter_destroy(void *data)
 
 	ndi_filter_disconnect_rename_handlers(f);
 
-	video_output_close(f->video_output);
-
 	ndi_sender_destroy(f);
 
-	gs_stagesurface_unmap(f->stagesurface);
-	gs_stagesurface_destroy(f->stagesurface);
-	gs_texrender_destroy(f->texrender);
+	obs_enter_graphics();
+	ndi_readback_cache_release(f->readback);
+	obs_leave_graphics();
 
 	if (f->audio_conv_buffer) {
 		obs_log(LOG_DEBUG, "ndi_filter_destroy: freeing %zu bytes", f->audio_conv_buffer_size);
@@ -558,8 +912,15 @@ void ndi_filter_tick(void *data, float)
 	auto f = (ndi_filter_t *)data;
 
 	obs_get_video_info(&f->ovi);
+	ndi_filter_refresh_tally(f);
+
+	// Skipped frames count as already rendered, so no rendering, readback or send happens for them
+	f->rendered = f->frame_count++ % f->frame_divisor != 0;
+}
 
-	f->rendered = false;
+void ndi_audiofilter_tick(void *data, float)
+{
+	ndi_filter_refresh_tally((ndi_filter_t *)data);
 }
 
 void ndi_filter_add(void *data, obs_source_t * /* parent */)
@@ -579,82 +940,98 @@ void ndi_filter_remove(void *data, obs_source_t * /* parent */)
 	ndi_sender_destroy(f);
 }
 
+// Audio callbacks between two logs of the time spent in ndi_filter_asyncaudio
+#define AUDIO_STATS_CALLBACKS 1000
+
+// OBS hands filters planar float audio. When the planes happen to be laid out back to back,
+// they already are an NDI FLTP frame and can be sent without copying them.
+static bool ndi_filter_audio_planes_contiguous(const obs_audio_data *audio_data, size_t channels, size_t stride)
+{
+	for (size_t i = 1; i < channels; i++) {
+		if (audio_data->data[i] != audio_data->data[0] + i * stride)
+			return false;
+	}
+	return true;
+}
+
 obs_audio_data *ndi_filter_asyncaudio(void *data, obs_audio_data *audio_data)
 {
 	// NOTE: The logic in this function should be similar to
 	// ndi-output.cpp/ndi_output_raw_audio(...)
 	auto f = (ndi_filter_t *)data;
 
-	pthread_mutex_lock(&f->ndi_sender_audio_mutex);
-
-	if (!f->ndi_sender) {
-		pthread_mutex_unlock(&f->ndi_sender_audio_mutex);
+	if (!audio_data->frames || !audio_data->data[0] || !f->audio_channels)
 		return audio_data;
-	}
-
-	auto now = std::chrono::steady_clock::now();
-	if (now - f->last_audio_conn_check >= std::chrono::seconds(1)) {
-		f->last_audio_conn_check = now;
-		int nc = ndiLib->send_get_no_connections(f->ndi_sender, 10);
-		if (nc != f->no_audio_connections) {
-			auto ndi_source = ndiLib->send_get_source_name(f->ndi_sender);
-			if (nc <= 0)
-				obs_log(LOG_DEBUG, "Dedicated NDI Output audio '%s' has no connections.",
-					ndi_source->p_ndi_name);
-			else if (f->no_audio_connections == 0)
-				obs_log(LOG_DEBUG, "Dedicated NDI Output audio '%s' has %d connections.",
-					ndi_source->p_ndi_name, nc);
-			f->no_audio_connections = nc;
-		}
-	}
 
-	pthread_mutex_unlock(&f->ndi_sender_audio_mutex);
-
-	obs_get_audio_info(&f->oai);
+	const uint64_t start_ns = os_gettime_ns();
 
 	NDIlib_audio_frame_v3_t audio_frame = {0};
 	audio_frame.sample_rate = f->oai.samples_per_sec;
-	audio_frame.no_channels = f->oai.speakers;
+	audio_frame.no_channels = (int)f->audio_channels;
 #ifdef SYNC_DEBUG
 	audio_frame.timestamp = audio_data->timestamp / 100;
 #endif
-	audio_frame.timecode = NDIlib_send_timecode_synthesize;
 	audio_frame.no_samples = audio_data->frames;
-	audio_frame.channel_stride_in_bytes =
-		audio_frame.no_samples *
-		4; // TODO: Check if this correct or should 4 be replaced by number of channels.
-	// audio_frame.FourCC = NDIlib_FourCC_audio_type_FLTP;
-	// audio_frame.p_data = p_frame;
+	audio_frame.FourCC = NDIlib_FourCC_audio_type_FLTP;
+	// Planar: each channel is `no_samples` floats, the next channel follows right after
+	audio_frame.channel_stride_in_bytes = audio_frame.no_samples * (int)sizeof(float);
 	audio_frame.p_metadata = NULL; // No metadata support yet!
 
-	const size_t data_size = audio_frame.no_channels * audio_frame.channel_stride_in_bytes;
-
-	if (data_size > f->audio_conv_buffer_size) {
-		obs_log(LOG_DEBUG, "ndi_filter_asyncaudio: growing audio_conv_buffer from %zu to %zu bytes",
-			f->audio_conv_buffer_size, data_size);
-		if (f->audio_conv_buffer) {
-			obs_log(LOG_DEBUG, "ndi_filter_asyncaudio: freeing %zu bytes", f->audio_conv_buffer_size);
+	const size_t stride = (size_t)audio_frame.channel_stride_in_bytes;
+	if (ndi_filter_audio_planes_contiguous(audio_data, f->audio_channels, stride)) {
+		audio_frame.p_data = audio_data->data[0];
+		f->audio_stats_direct++;
+	} else {
+		const size_t data_size = f->audio_channels * stride;
+		if (data_size > f->audio_conv_buffer_size) {
+			obs_log(LOG_DEBUG, "ndi_filter_asyncaudio: growing audio_conv_buffer from %zu to %zu bytes",
+				f->audio_conv_buffer_size, data_size);
 			bfree(f->audio_conv_buffer);
+			f->audio_conv_buffer = (uint8_t *)bmalloc(data_size);
+			f->audio_conv_buffer_size = data_size;
 		}
-		obs_log(LOG_DEBUG, "ndi_filter_asyncaudio: allocating %zu bytes", data_size);
-		f->audio_conv_buffer = (uint8_t *)bmalloc(data_size);
-		f->audio_conv_buffer_size = data_size;
-	}
 
-	for (int i = 0; i < audio_frame.no_channels; ++i) {
-		memcpy(f->audio_conv_buffer + (i * audio_frame.channel_stride_in_bytes), audio_data->data[i],
-		       audio_frame.channel_stride_in_bytes);
+		for (size_t i = 0; i < f->audio_channels; ++i) {
+			if (audio_data->data[i])
+				memcpy(f->audio_conv_buffer + i * stride, audio_data->data[i], stride);
+			else
+				memset(f->audio_conv_buffer + i * stride, 0, stride);
+		}
+		audio_frame.p_data = f->audio_conv_buffer;
 	}
 
-	audio_frame.p_data = f->audio_conv_buffer;
+	// Audio timestamps are the source's own; only trust them when they are on the OBS clock
+	const bool on_obs_clock = audio_data->timestamp <= start_ns &&
+				  start_ns - audio_data->timestamp < OBS_CLOCK_MAX_SKEW_NS;
 
+	// Connection changes are logged by the sender monitor, nothing to poll here
 	pthread_mutex_lock(&f->ndi_sender_audio_mutex);
+	audio_frame.timecode = on_obs_clock ? ndi_filter_timecode(f, audio_data->timestamp)
+					    : NDIlib_send_timecode_synthesize;
 	SYNC_DEBUG_LOG_AUDIO_TIME("NDI <- ndi_filter", obs_source_get_name(f->obs_source), audio_frame.timestamp * 100,
 				  (float *)audio_frame.p_data, audio_frame.no_samples, audio_frame.sample_rate);
 	if (f->ndi_sender)
 		ndiLib->send_send_audio_v3(f->ndi_sender, &audio_frame);
 	pthread_mutex_unlock(&f->ndi_sender_audio_mutex);
 
+	const uint64_t end_ns = os_gettime_ns();
+	if (on_obs_clock) {
+		uint64_t latency = end_ns - audio_data->timestamp;
+		f->audio_latency_avg_ns = f->audio_latency_avg_ns ? (f->audio_latency_avg_ns * 63 + latency) / 64
+								  : latency;
+		os_atomic_set_long(&f->audio_latency_us, (long)std::max<uint64_t>(f->audio_latency_avg_ns / 1000, 1));
+	}
+
+	f->audio_stats_ns += end_ns - start_ns;
+	if (++f->audio_stats_callbacks >= AUDIO_STATS_CALLBACKS) {
+		obs_log(LOG_DEBUG, "'%s' ndi_filter_asyncaudio: %.1f us per callback, %llu of %llu sent without copy",
+			obs_source_get_name(f->obs_source), f->audio_stats_ns / 1000.0 / f->audio_stats_callbacks,
+			(unsigned long long)f->audio_stats_direct, (unsigned long long)f->audio_stats_callbacks);
+		f->audio_stats_callbacks = 0;
+		f->audio_stats_direct = 0;
+		f->audio_stats_ns = 0;
+	}
+
 	return audio_data;
 }
 
@@ -700,6 +1077,7 @@ obs_source_info create_ndi_audiofilter_info()
 	ndi_filter_info.filter_remove = ndi_filter_remove;
 	ndi_filter_info.update = ndi_filter_update;
 	ndi_filter_info.destroy = ndi_filter_destroy_audioonly;
+	ndi_filter_info.video_tick = ndi_audiofilter_tick;
 
 	ndi_filter_info.filter_audio = ndi_filter_asyncaudio;
 
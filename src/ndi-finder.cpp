@@ -1,67 +1,275 @@
 #include "ndi-finder.h"
 
-std::vector<std::string> NDIFinder::NDISourceList;
-std::chrono::time_point<std::chrono::steady_clock> NDIFinder::lastRefreshTime;
-std::mutex NDIFinder::listMutex;
-bool NDIFinder::isRefreshing = false;
+#include <algorithm>
+#include <iterator>
 
-std::vector<std::string> NDIFinder::getNDISourceList(Callback callback)
+// Longest time a discovery thread sleeps before checking whether it must stop
+#define FINDER_WAIT_MS 1000
+
+struct NDIFinder::Discovery {
+	std::string groups;
+	std::string extraIps;
+	std::thread thread;
+	std::atomic<bool> running{true};
+	std::atomic<bool> finished{false};
+
+	std::vector<std::string> sources;
+	std::mutex sourcesMutex;
+
+	// Called with the mutex held, so removing a listener waits for a notification in progress
+	std::vector<std::pair<const void *, Listener>> listeners;
+	std::mutex listenersMutex;
+};
+
+std::vector<std::shared_ptr<NDIFinder::Discovery>> NDIFinder::discoveries;
+std::vector<std::shared_ptr<NDIFinder::Discovery>> NDIFinder::retired;
+std::mutex NDIFinder::discoveriesMutex;
+std::atomic<bool> NDIFinder::started{false};
+
+// Groups and IPs are compared as NDI reads them: comma-separated, surrounding spaces ignored
+static std::string normalize_list(const std::string &list)
+{
+	std::string result;
+	size_t begin = 0;
+	while (begin <= list.size()) {
+		size_t end = list.find(',', begin);
+		if (end == std::string::npos)
+			end = list.size();
+		size_t first = list.find_first_not_of(" \t", begin);
+		size_t last = list.find_last_not_of(" \t", end - 1);
+		if (first != std::string::npos && first < end && last >= first) {
+			if (!result.empty())
+				result += ',';
+			result += list.substr(first, last - first + 1);
+		}
+		begin = end + 1;
+	}
+	return result;
+}
+
+// The default discovery keeps running without listeners, for properties opened without a source
+static bool is_default(const std::string &groups, const std::string &extraIps)
 {
-	std::lock_guard<std::mutex> lock(listMutex);
-	auto now = std::chrono::steady_clock::now();
-	auto duration = std::chrono::duration_cast<std::chrono::seconds>(now - lastRefreshTime).count();
+	return groups.empty() && extraIps.empty();
+}
 
-	if (duration > 5 && !isRefreshing) {
-		isRefreshing = true;
-		std::thread(refreshNDISourceList, callback).detach();
+void NDIFinder::start()
+{
+	// Safety check to avoid crash if the Lib is not loaded.
+	if (!ndiLib || started.exchange(true)) {
+		return;
 	}
 
-	return NDISourceList;
+	obs_log(LOG_DEBUG, "NDIFinder::start: starting NDI discovery");
+	std::lock_guard<std::mutex> lock(discoveriesMutex);
+	launch("", "");
 }
 
-void NDIFinder::refreshNDISourceList(Callback callback)
+void NDIFinder::stop()
 {
-	retrieveNDISourceList();
-	std::lock_guard<std::mutex> lock(listMutex);
-	lastRefreshTime = std::chrono::steady_clock::now();
-	callback(&NDISourceList);
-	isRefreshing = false;
+	std::vector<std::shared_ptr<Discovery>> stopping;
+	{
+		std::lock_guard<std::mutex> lock(discoveriesMutex);
+		started = false;
+		stopping.swap(retired);
+		stopping.insert(stopping.end(), discoveries.begin(), discoveries.end());
+		discoveries.clear();
+	}
+
+	for (auto &discovery : stopping) {
+		discovery->running = false;
+	}
+	for (auto &discovery : stopping) {
+		if (discovery->thread.joinable())
+			discovery->thread.join();
+	}
+
+	obs_log(LOG_DEBUG, "NDIFinder::stop: NDI discovery stopped");
 }
 
-void NDIFinder::retrieveNDISourceList()
+std::shared_ptr<NDIFinder::Discovery> NDIFinder::find(const std::string &groups, const std::string &extraIps)
 {
-	// Safety check to avoid crash if the Lib is not loaded.
-	if (!ndiLib) {
+	for (auto &discovery : discoveries) {
+		if (discovery->groups == groups && discovery->extraIps == extraIps)
+			return discovery;
+	}
+	return nullptr;
+}
+
+// discoveriesMutex must be held
+std::shared_ptr<NDIFinder::Discovery> NDIFinder::launch(const std::string &groups, const std::string &extraIps)
+{
+	auto discovery = std::make_shared<Discovery>();
+	discovery->groups = groups;
+	discovery->extraIps = extraIps;
+	discovery->thread = std::thread(discover, discovery);
+	discoveries.push_back(discovery);
+	obs_log(LOG_DEBUG, "NDIFinder::launch: discovery started (groups='%s', extra_ips='%s')", groups.c_str(),
+		extraIps.c_str());
+	return discovery;
+}
+
+// discoveriesMutex must be held. The thread is not waited for, it ends within FINDER_WAIT_MS.
+void NDIFinder::retire(const std::shared_ptr<Discovery> &discovery)
+{
+	discovery->running = false;
+	discoveries.erase(std::remove(discoveries.begin(), discoveries.end(), discovery), discoveries.end());
+
+	// Threads that ended since the last time are joined right away
+	for (auto it = retired.begin(); it != retired.end();) {
+		if ((*it)->finished) {
+			(*it)->thread.join();
+			it = retired.erase(it);
+		} else {
+			++it;
+		}
+	}
+	retired.push_back(discovery);
+
+	obs_log(LOG_DEBUG, "NDIFinder::retire: discovery stopped (groups='%s', extra_ips='%s')",
+		discovery->groups.c_str(), discovery->extraIps.c_str());
+}
+
+std::vector<std::string> NDIFinder::getNDISourceList(const std::string &groups, const std::string &extraIps)
+{
+	std::shared_ptr<Discovery> discovery;
+	{
+		std::lock_guard<std::mutex> lock(discoveriesMutex);
+		discovery = find(normalize_list(groups), normalize_list(extraIps));
+	}
+	if (!discovery) {
+		return {};
+	}
+
+	std::lock_guard<std::mutex> lock(discovery->sourcesMutex);
+	return discovery->sources;
+}
+
+void NDIFinder::addListener(const void *owner, const std::string &groups, const std::string &extraIps,
+			    Listener listener)
+{
+	auto key_groups = normalize_list(groups);
+	auto key_extra_ips = normalize_list(extraIps);
+
+	std::lock_guard<std::mutex> lock(discoveriesMutex);
+	if (!started) {
 		return;
 	}
 
+	auto discovery = find(key_groups, key_extra_ips);
+	for (auto &other : std::vector<std::shared_ptr<Discovery>>(discoveries)) {
+		if (other == discovery)
+			continue;
+		std::lock_guard<std::mutex> listeners_lock(other->listenersMutex);
+		auto &l = other->listeners;
+		auto it = std::find_if(l.begin(), l.end(), [owner](const auto &entry) { return entry.first == owner; });
+		if (it == l.end())
+			continue;
+		l.erase(it);
+		if (l.empty() && !is_default(other->groups, other->extraIps))
+			retire(other);
+	}
+
+	if (!discovery) {
+		discovery = launch(key_groups, key_extra_ips);
+	}
+
+	std::lock_guard<std::mutex> listeners_lock(discovery->listenersMutex);
+	{
+		std::lock_guard<std::mutex> sources_lock(discovery->sourcesMutex);
+		listener(discovery->sources, discovery->sources, {});
+	}
+	for (auto &entry : discovery->listeners) {
+		if (entry.first == owner) {
+			entry.second = std::move(listener);
+			return;
+		}
+	}
+	discovery->listeners.emplace_back(owner, std::move(listener));
+}
+
+void NDIFinder::removeListener(const void *owner)
+{
+	std::lock_guard<std::mutex> lock(discoveriesMutex);
+	for (auto &discovery : std::vector<std::shared_ptr<Discovery>>(discoveries)) {
+		std::lock_guard<std::mutex> listeners_lock(discovery->listenersMutex);
+		auto &l = discovery->listeners;
+		auto it = std::find_if(l.begin(), l.end(), [owner](const auto &entry) { return entry.first == owner; });
+		if (it == l.end())
+			continue;
+		l.erase(it);
+		if (l.empty() && !is_default(discovery->groups, discovery->extraIps))
+			retire(discovery);
+	}
+}
+
+void NDIFinder::discover(std::shared_ptr<Discovery> discovery)
+{
 	NDIlib_find_create_t find_desc = {0};
 	find_desc.show_local_sources = true;
-	find_desc.p_groups = NULL;
+	find_desc.p_groups = discovery->groups.empty() ? NULL : discovery->groups.c_str();
+	find_desc.p_extra_ips = discovery->extraIps.empty() ? NULL : discovery->extraIps.c_str();
 	NDIlib_find_instance_t ndi_find = ndiLib->find_create_v2(&find_desc);
 
 	if (!ndi_find) {
+		obs_log(LOG_WARNING, "WARN-420 - NDI source discovery could not be started");
+		obs_log(LOG_DEBUG, "NDIFinder::discover: find_create_v2 failed (groups='%s', extra_ips='%s')",
+			discovery->groups.c_str(), discovery->extraIps.c_str());
+		discovery->finished = true;
 		return;
 	}
 
-	uint32_t n_sources = 0;
-	uint32_t last_n_sources = 0;
-	const NDIlib_source_t *sources = NULL;
-	do {
-		ndiLib->find_wait_for_sources(ndi_find, 1000);
-		last_n_sources = n_sources;
-		sources = ndiLib->find_get_current_sources(ndi_find, &n_sources);
-	} while (n_sources > last_n_sources);
+	// Sorted, so that changes are found with a single pass over the old and new lists
+	std::vector<std::string> known;
 
-	std::vector<std::string> newList;
-	for (uint32_t i = 0; i < n_sources; ++i) {
-		newList.push_back(sources[i].p_ndi_name);
-	}
+	while (discovery->running) {
+		// Blocks until the list of sources changed, or for at most FINDER_WAIT_MS
+		if (!ndiLib->find_wait_for_sources(ndi_find, FINDER_WAIT_MS)) {
+			continue;
+		}
 
-	{
-		std::lock_guard<std::mutex> lock(listMutex);
-		NDISourceList = newList;
+		uint32_t n_sources = 0;
+		const NDIlib_source_t *sources = ndiLib->find_get_current_sources(ndi_find, &n_sources);
+
+		std::vector<std::string> current;
+		current.reserve(n_sources);
+		for (uint32_t i = 0; i < n_sources; ++i) {
+			current.push_back(sources[i].p_ndi_name);
+		}
+		std::sort(current.begin(), current.end());
+		current.erase(std::unique(current.begin(), current.end()), current.end());
+
+		std::vector<std::string> added;
+		std::vector<std::string> removed;
+		std::set_difference(current.begin(), current.end(), known.begin(), known.end(),
+				    std::back_inserter(added));
+		std::set_difference(known.begin(), known.end(), current.begin(), current.end(),
+				    std::back_inserter(removed));
+		if (added.empty() && removed.empty()) {
+			continue;
+		}
+
+		for (auto &name : added) {
+			obs_log(LOG_DEBUG, "NDIFinder::discover: source added '%s' (groups='%s')", name.c_str(),
+				discovery->groups.c_str());
+		}
+		for (auto &name : removed) {
+			obs_log(LOG_DEBUG, "NDIFinder::discover: source removed '%s' (groups='%s')", name.c_str(),
+				discovery->groups.c_str());
+		}
+
+		known = std::move(current);
+		{
+			std::lock_guard<std::mutex> lock(discovery->sourcesMutex);
+			discovery->sources = known;
+		}
+
+		std::lock_guard<std::mutex> lock(discovery->listenersMutex);
+		for (auto &entry : discovery->listeners) {
+			entry.second(known, added, removed);
+		}
 	}
 
 	ndiLib->find_destroy(ndi_find);
+	discovery->finished = true;
 }
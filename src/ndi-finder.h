@@ -4,20 +4,51 @@
 #include <string>
 #include <thread>
 #include <mutex>
+#include <atomic>
+#include <memory>
 #include <functional>
-#include <chrono>
 #include <Processing.NDI.Lib.h>
 
+// Long-lived NDI discovery: one finder instance per set of discovery groups and extra IPs, kept
+// by a background thread that sleeps in find_wait_for_sources until the network changes, so an
+// idle finder costs no CPU and the current source list is available right away.
+//
+// The default discovery (NDI's default groups, no extra IPs) runs from start() to stop(). Others
+// run while they have listeners.
 class NDIFinder {
 public:
-	using Callback = std::function<void(void *)>;
-	static std::vector<std::string> getNDISourceList(Callback callback);
+	// Called from the discovery thread with the current sources, and those that appeared and
+	// disappeared. Called with the listeners' lock held: it must return quickly, and must not call
+	// into OBS nor NDIFinder, e.g. only flag the change for another thread.
+	using Listener = std::function<void(const std::vector<std::string> &sources,
+					    const std::vector<std::string> &added,
+					    const std::vector<std::string> &removed)>;
+
+	// Start and stop discovery. The NDI library must be loaded and initialized.
+	static void start();
+	static void stop();
+
+	// Comma-separated groups and extra IPs; empty for NDI's defaults.
+	// The list is empty while no discovery runs for them.
+	static std::vector<std::string> getNDISourceList(const std::string &groups = "",
+							 const std::string &extraIps = "");
+
+	// One listener per owner, which moves it from its previous groups and extra IPs if they changed.
+	// A new listener is called right away with the sources already discovered.
+	// Once removeListener returned, the listener is no longer called.
+	static void addListener(const void *owner, const std::string &groups, const std::string &extraIps,
+				Listener listener);
+	static void removeListener(const void *owner);
 
 private:
-	static std::vector<std::string> NDISourceList;
-	static std::chrono::time_point<std::chrono::steady_clock> lastRefreshTime;
-	static std::mutex listMutex;
-	static bool isRefreshing;
-	static void refreshNDISourceList(Callback callback);
-	static void retrieveNDISourceList();
+	struct Discovery;
+	static std::vector<std::shared_ptr<Discovery>> discoveries;
+	// Discoveries without listeners anymore whose thread may not have ended yet
+	static std::vector<std::shared_ptr<Discovery>> retired;
+	static std::mutex discoveriesMutex;
+	static std::atomic<bool> started;
+	static std::shared_ptr<Discovery> find(const std::string &groups, const std::string &extraIps);
+	static std::shared_ptr<Discovery> launch(const std::string &groups, const std::string &extraIps);
+	static void retire(const std::shared_ptr<Discovery> &discovery);
+	static void discover(std::shared_ptr<Discovery> discovery);
 };
@@ -17,8 +17,15 @@
 
 #include "plugin-main.h"
 #include "sync-debug.h"
+#include "ndi-sender-monitor.h"
+#include "ndi-sender-registry.h"
+#include "ndi-send-queue.h"
+#include "ndi-copy.h"
+#include "ndi-source-output.h"
 #include <util/threading.h>
-#include <chrono>
+#include <initializer_list>
+#include <utility>
+#include <algorithm>
 
 // #include "plugin-support.h"
 
@@ -68,30 +75,100 @@ typedef struct {
 
 	NDIlib_send_instance_t ndi_sender;
 	pthread_mutex_t ndi_sender_mutex;
+	ndi_sender_monitor_t *ndi_sender_monitor;
+	// NDI send calls run on this queue's own thread, never on OBS's output threads
+	ndi_send_queue_t *ndi_send_queue;
+
+	// When nobody is connected, still send one frame per second (instead of none)
+	// so receivers listing sources with thumbnails keep seeing a picture.
+	bool idle_keepalive;
+	uint64_t last_video_sent_ns;
+
+	ndi_send_pacing_t pacing;
+
+	// Only every Nth OBS frame is sent, before any conversion or copy
+	uint32_t frame_divisor;
+	uint64_t frame_count;
+
+	// With alpha ("ndi_alpha_output"), the program is rendered with its transparency and packed to
+	// UYVA on the GPU by a source output sending through ndi_send_queue. That output type only
+	// captures audio, so OBS does not convert any raw canvas frame for it.
+	bool with_alpha;
+	ndi_source_output_t *alpha_output;
 
 	uint32_t frame_width;
 	uint32_t frame_height;
 	NDIlib_FourCC_video_type_e frame_fourcc;
-	double video_framerate;
+	uint32_t fps_num;
+	uint32_t fps_den;
+
+	// Frame header fields that do not change while the output is started.
+	// Only the data pointer, stride and timestamp are filled per frame.
+	NDIlib_video_frame_v2_t video_frame_template;
+
+	// Layout of the (tightly packed) planes expected by NDI for frame_fourcc
+	size_t video_planes;
+	uint32_t plane_row_bytes[MAX_AV_PLANES];
+	uint32_t plane_rows[MAX_AV_PLANES];
+	size_t video_frame_size;
 
 	size_t audio_channels;
 	uint32_t audio_samplerate;
 
-	uint8_t *conv_buffer;
+	// Number of samples per channel in each NDI audio frame (a multiple of OBS's
+	// AUDIO_OUTPUT_FRAMES); larger frames mean fewer, bigger packets on the network.
+	uint32_t audio_frame_samples;
+	// Audio frame being filled, sent when it holds audio_frame_samples samples
+	ndi_audio_slot_t *audio_pending;
+	uint32_t audio_pending_samples;
+
 	uint32_t conv_linesize;
 	uyvy_conv_function conv_function;
-
-	uint8_t *audio_conv_buffer;
-	size_t audio_conv_buffer_size;
-	int32_t no_connections;
-	std::chrono::time_point<std::chrono::steady_clock> last_conn_check;
 } ndi_output_t;
 
+// Queue depths: a couple of frames absorb short NDI stalls without adding much latency
+#define VIDEO_QUEUE_DEPTH 3
+#define AUDIO_QUEUE_DEPTH 16
+#define AUDIO_FRAME_SAMPLES_MAX (AUDIO_OUTPUT_FRAMES * 8)
+
+static void ndi_output_set_planes(ndi_output_t *o, std::initializer_list<std::pair<uint32_t, uint32_t>> planes)
+{
+	o->video_planes = 0;
+	o->video_frame_size = 0;
+	for (auto &plane : planes) {
+		o->plane_row_bytes[o->video_planes] = plane.first;
+		o->plane_rows[o->video_planes] = plane.second;
+		o->video_frame_size += (size_t)plane.first * (size_t)plane.second;
+		o->video_planes++;
+	}
+}
+
+// Send the partially filled audio frame, if any
+static void ndi_output_flush_audio(ndi_output_t *o)
+{
+	auto slot = o->audio_pending;
+	if (!slot)
+		return;
+
+	o->audio_pending = nullptr;
+	slot->frame.no_samples = (int)o->audio_pending_samples;
+	o->audio_pending_samples = 0;
+
+	SYNC_DEBUG_LOG_AUDIO_TIME("NDI <- ndi_output", o->ndi_name, slot->frame.timestamp * 100,
+				  (float *)slot->frame.p_data, slot->frame.no_samples, slot->frame.sample_rate);
+	ndi_send_queue_push_audio(o->ndi_send_queue, slot);
+}
+
 const char *ndi_output_getname(void *)
 {
 	return obs_module_text("NDIPlugin.OutputName");
 }
 
+const char *ndi_alpha_output_getname(void *)
+{
+	return obs_module_text("NDIPlugin.AlphaOutputName");
+}
+
 obs_properties_t *ndi_output_getproperties(void *)
 {
 	obs_log(LOG_DEBUG, "+ndi_output_getproperties()");
@@ -102,6 +179,23 @@ obs_properties_t *ndi_output_getproperties(void *)
 	obs_properties_add_text(props, "ndi_name", obs_module_text("NDIPlugin.OutputProps.NDIName"), OBS_TEXT_DEFAULT);
 	obs_properties_add_text(props, "ndi_groups", obs_module_text("NDIPlugin.OutputProps.NDIGroups"),
 				OBS_TEXT_DEFAULT);
+	obs_properties_add_bool(props, "idle_keepalive", obs_module_text("NDIPlugin.OutputProps.IdleKeepalive"));
+	obs_property_t *pacing = obs_properties_add_list(props, "pacing",
+							 obs_module_text("NDIPlugin.OutputProps.Pacing"),
+							 OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(pacing, obs_module_text("NDIPlugin.OutputProps.Pacing.None"), NDI_SEND_PACING_NONE);
+	obs_property_list_add_int(pacing, obs_module_text("NDIPlugin.OutputProps.Pacing.Paced"), NDI_SEND_PACING_PACED);
+	obs_property_list_add_int(pacing, obs_module_text("NDIPlugin.OutputProps.Pacing.Clocked"),
+				  NDI_SEND_PACING_CLOCKED);
+	obs_property_t *frame_divisor = obs_properties_add_list(props, "frame_divisor",
+								obs_module_text("NDIPlugin.OutputProps.FrameRate"),
+								OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(frame_divisor, obs_module_text("NDIPlugin.FrameRate.Canvas"), 1);
+	obs_property_list_add_int(frame_divisor, obs_module_text("NDIPlugin.FrameRate.Half"), 2);
+	obs_property_list_add_int(frame_divisor, obs_module_text("NDIPlugin.FrameRate.Third"), 3);
+	obs_property_list_add_int(frame_divisor, obs_module_text("NDIPlugin.FrameRate.Quarter"), 4);
+	obs_properties_add_int(props, "audio_frame_samples", obs_module_text("NDIPlugin.OutputProps.AudioFrameSamples"),
+			       AUDIO_OUTPUT_FRAMES, AUDIO_FRAME_SAMPLES_MAX, AUDIO_OUTPUT_FRAMES);
 
 	obs_log(LOG_DEBUG, "-ndi_output_getproperties()");
 
@@ -115,11 +209,29 @@ void ndi_output_getdefaults(obs_data_t *settings)
 	obs_data_set_default_string(settings, "ndi_groups", "DistroAV output (changeme)");
 	obs_data_set_default_bool(settings, "uses_video", true);
 	obs_data_set_default_bool(settings, "uses_audio", true);
+	obs_data_set_default_bool(settings, "idle_keepalive", true);
+	obs_data_set_default_int(settings, "audio_frame_samples", AUDIO_OUTPUT_FRAMES);
+	obs_data_set_default_int(settings, "pacing", NDI_SEND_PACING_NONE);
+	obs_data_set_default_int(settings, "frame_divisor", 1);
 	obs_log(LOG_DEBUG, "-ndi_output_getdefaults()");
 }
 
 void ndi_output_update(void *data, obs_data_t *settings);
 
+// Called from the sender monitor thread when a receiver puts the output on program or preview
+static void ndi_output_on_tally(void *data, bool on_program, bool on_preview)
+{
+	auto o = (ndi_output_t *)data;
+
+	struct calldata cd;
+	uint8_t stack[128];
+	calldata_init_fixed(&cd, stack, sizeof(stack));
+	calldata_set_ptr(&cd, "output", o->output);
+	calldata_set_bool(&cd, "on_program", on_program);
+	calldata_set_bool(&cd, "on_preview", on_preview);
+	signal_handler_signal(obs_output_get_signal_handler(o->output), "ndi_tally", &cd);
+}
+
 void *ndi_output_create(obs_data_t *settings, obs_output_t *output)
 {
 	auto name = obs_data_get_string(settings, "ndi_name");
@@ -127,13 +239,12 @@ void *ndi_output_create(obs_data_t *settings, obs_output_t *output)
 	obs_log(LOG_DEBUG, "+ndi_output_create(name='%s', groups='%s', ...)", name, groups);
 	auto o = (ndi_output_t *)bzalloc(sizeof(ndi_output_t));
 	o->output = output;
+	o->with_alpha = strcmp(obs_output_get_id(output), "ndi_alpha_output") == 0;
 	pthread_mutex_init(&o->ndi_sender_mutex, NULL);
+	signal_handler_add(obs_output_get_signal_handler(output),
+			   "void ndi_tally(ptr output, bool on_program, bool on_preview)");
 	ndi_output_update(o, settings);
 
-	// initialize last_conn_check so first check will occur immediately
-	o->no_connections = -1;
-	o->last_conn_check = std::chrono::steady_clock::time_point();
-
 	obs_log(LOG_DEBUG, "-ndi_output_create(name='%s', groups='%s', ...)", name, groups);
 	return o;
 }
@@ -167,7 +278,22 @@ bool ndi_output_start(void *data)
 		return false;
 	}
 
-	if (o->uses_video && video) {
+	if (o->uses_video && video && o->with_alpha) {
+		// Whatever the canvas format: the frames are rendered from the program, not converted.
+		// The slots are sized for what the source output renders: the canvas scaled to the
+		// output height, exactly as ndi_source_output_create computes it.
+		const video_output_info *voi = video_output_get_info(video);
+		obs_video_info ovi;
+		obs_get_video_info(&ovi);
+		ndi_source_output_get_size(ovi.base_width, ovi.base_height, voi->height, &o->frame_width,
+					   &o->frame_height);
+		o->fps_num = ovi.fps_num;
+		o->fps_den = ovi.fps_den * o->frame_divisor;
+		o->video_frame_size = ndi_readback_frame_size(NDI_PIXEL_FORMAT_BGRA, o->frame_width, o->frame_height);
+
+		obs_log(LOG_DEBUG, "'%s' ndi_output_start: %ux%u @ %u/%u fps with alpha", name, o->frame_width,
+			o->frame_height, o->fps_num, o->fps_den);
+	} else if (o->uses_video && video) {
 		video_format format = video_output_get_format(video);
 		uint32_t width = video_output_get_width(video);
 		uint32_t height = video_output_get_height(video);
@@ -177,27 +303,32 @@ bool ndi_output_start(void *data)
 			o->conv_function = convert_i444_to_uyvy;
 			o->frame_fourcc = NDIlib_FourCC_video_type_UYVY;
 			o->conv_linesize = width * 2;
-			o->conv_buffer = new uint8_t[(size_t)height * (size_t)o->conv_linesize * 2]();
+			ndi_output_set_planes(o, {{o->conv_linesize, height}});
 			break;
 
 		case VIDEO_FORMAT_NV12:
 			o->frame_fourcc = NDIlib_FourCC_video_type_NV12;
+			ndi_output_set_planes(o, {{width, height}, {width, height / 2}});
 			break;
 
 		case VIDEO_FORMAT_I420:
 			o->frame_fourcc = NDIlib_FourCC_video_type_I420;
+			ndi_output_set_planes(o, {{width, height}, {width / 2, height / 2}, {width / 2, height / 2}});
 			break;
 
 		case VIDEO_FORMAT_RGBA:
 			o->frame_fourcc = NDIlib_FourCC_video_type_RGBA;
+			ndi_output_set_planes(o, {{width * 4, height}});
 			break;
 
 		case VIDEO_FORMAT_BGRA:
 			o->frame_fourcc = NDIlib_FourCC_video_type_BGRA;
+			ndi_output_set_planes(o, {{width * 4, height}});
 			break;
 
 		case VIDEO_FORMAT_BGRX:
 			o->frame_fourcc = NDIlib_FourCC_video_type_BGRX;
+			ndi_output_set_planes(o, {{width * 4, height}});
 			break;
 
 		default:
@@ -210,15 +341,47 @@ bool ndi_output_start(void *data)
 			return false;
 		}
 
+		// Use OBS's exact rational frame rate so fractional rates (29.97, 59.94)
+		// are advertised as 30000/1001, 60000/1001 and not rounded. Decimated
+		// rates stay exact too: 1/2 of 60000/1001 is 60000/2002.
+		const video_output_info *voi = video_output_get_info(video);
 		o->frame_width = width;
 		o->frame_height = height;
-		o->video_framerate = video_output_get_frame_rate(video);
+		o->fps_num = voi->fps_num;
+		o->fps_den = voi->fps_den * o->frame_divisor;
+		o->frame_count = 0;
+
+		NDIlib_video_frame_v2_t video_frame = {0};
+		video_frame.xres = width;
+		video_frame.yres = height;
+		video_frame.FourCC = o->frame_fourcc;
+		video_frame.frame_rate_N = (int)o->fps_num;
+		video_frame.frame_rate_D = (int)o->fps_den;
+		video_frame.picture_aspect_ratio = 0; // square pixels
+		video_frame.frame_format_type = NDIlib_frame_format_type_progressive;
+		video_frame.timecode = NDIlib_send_timecode_synthesize;
+		video_frame.line_stride_in_bytes = (int)o->plane_row_bytes[0];
+		o->video_frame_template = video_frame;
+
+		obs_log(LOG_DEBUG, "'%s' ndi_output_start: %ux%u @ %u/%u fps", name, width, height, o->fps_num,
+			o->fps_den);
 		flags |= OBS_OUTPUT_VIDEO;
 	}
 
+	bool alpha_video = o->uses_video && video && o->with_alpha;
+
+	size_t audio_depth = 0;
 	if (o->uses_audio && audio) {
-		o->audio_samplerate = audio_output_get_sample_rate(audio);
-		o->audio_channels = audio_output_get_channels(audio);
+		const audio_output_info *aoi = audio_output_get_info(audio);
+		o->audio_samplerate = aoi->samples_per_sec;
+		o->audio_channels = get_audio_channels(aoi->speakers);
+		o->audio_pending = nullptr;
+		o->audio_pending_samples = 0;
+		// Keep roughly the same amount of queued audio whatever the frame size
+		audio_depth = std::max<size_t>(4, AUDIO_QUEUE_DEPTH * AUDIO_OUTPUT_FRAMES / o->audio_frame_samples);
+
+		obs_log(LOG_DEBUG, "'%s' ndi_output_start: audio %zu channels @ %u Hz, %u samples per frame", name,
+			o->audio_channels, o->audio_samplerate, o->audio_frame_samples);
 		flags |= OBS_OUTPUT_AUDIO;
 	}
 
@@ -228,20 +391,54 @@ bool ndi_output_start(void *data)
 		send_desc.p_groups = groups;
 	else
 		send_desc.p_groups = nullptr;
-	send_desc.clock_video = false;
+	// With NDI clocking, the video send blocks until the frame is due. This happens on the
+	// send queue's thread, so OBS's output thread is never held up by it.
+	send_desc.clock_video = o->pacing == NDI_SEND_PACING_CLOCKED;
 	send_desc.clock_audio = false;
 
 	pthread_mutex_lock(&o->ndi_sender_mutex);
-	o->ndi_sender = ndiLib->send_create(&send_desc);
+	o->ndi_sender = ndi_sender_registry_acquire(&send_desc, o, obs_output_get_name(o->output));
 
 	if (o->ndi_sender) {
-		o->started = obs_output_begin_data_capture(o->output, flags);
+		o->ndi_sender_monitor = ndi_sender_monitor_create(o->ndi_sender, name);
+		ndi_sender_monitor_set_tally_callback(o->ndi_sender_monitor, ndi_output_on_tally, o);
+		o->ndi_send_queue = ndi_send_queue_create(
+			o->ndi_sender, name, (flags & OBS_OUTPUT_VIDEO) || alpha_video ? o->video_frame_size : 0,
+			VIDEO_QUEUE_DEPTH,
+			(flags & OBS_OUTPUT_AUDIO) ? o->audio_channels * o->audio_frame_samples * sizeof(float) : 0,
+			audio_depth);
+		if ((flags & OBS_OUTPUT_VIDEO) || alpha_video)
+			ndi_send_queue_set_video_rate(o->ndi_send_queue, o->fps_num, o->fps_den, o->pacing);
+		o->last_video_sent_ns = 0;
+
+		if (alpha_video) {
+			ndi_source_output_info_t info = {};
+			info.ndi_name = name;
+			info.height = o->frame_height;
+			info.pixel_format = NDI_PIXEL_FORMAT_UYVA;
+			info.frame_divisor = o->frame_divisor;
+			info.program = true;
+			info.send_queue = o->ndi_send_queue;
+			info.sender_monitor = o->ndi_sender_monitor;
+			o->alpha_output = ndi_source_output_create(&info);
+		}
+
+		o->started = (!alpha_video || o->alpha_output) && obs_output_begin_data_capture(o->output, flags);
 		if (o->started) {
 			obs_log(LOG_INFO, "NDI Output started successfully. '%s'", name);
 			obs_log(LOG_DEBUG, "'%s' ndi_output_start: ndi output started", name);
 		} else {
 			obs_log(LOG_WARNING, "WARN-415 - NDI Sender data capture failed. '%s'", name);
 			obs_log(LOG_DEBUG, "'%s' ndi_output_start: data capture start failed", name);
+			ndi_source_output_destroy(o->alpha_output);
+			o->alpha_output = nullptr;
+			ndi_send_queue_destroy(o->ndi_send_queue);
+			o->ndi_send_queue = nullptr;
+			ndi_sender_monitor_destroy(o->ndi_sender_monitor);
+			o->ndi_sender_monitor = nullptr;
+			// Not announced on the network while the output is stopped
+			ndi_sender_registry_release(o->ndi_sender, o);
+			o->ndi_sender = nullptr;
 		}
 	} else {
 		obs_log(LOG_WARNING, "WARN-416 - NDI Sender initialisation failed. '%s'", name);
@@ -265,6 +462,15 @@ void ndi_output_update(void *data, obs_data_t *settings)
 	o->ndi_groups = groups;
 	o->uses_video = obs_data_get_bool(settings, "uses_video");
 	o->uses_audio = obs_data_get_bool(settings, "uses_audio");
+	o->idle_keepalive = obs_data_get_bool(settings, "idle_keepalive");
+	o->pacing = (ndi_send_pacing_t)obs_data_get_int(settings, "pacing");
+	o->frame_divisor = (uint32_t)std::max<long long>(obs_data_get_int(settings, "frame_divisor"), 1);
+
+	// Takes effect on the next start
+	auto audio_frame_samples = (uint32_t)obs_data_get_int(settings, "audio_frame_samples");
+	audio_frame_samples -= audio_frame_samples % AUDIO_OUTPUT_FRAMES;
+	o->audio_frame_samples =
+		std::clamp<uint32_t>(audio_frame_samples, AUDIO_OUTPUT_FRAMES, AUDIO_FRAME_SAMPLES_MAX);
 
 	obs_log(LOG_INFO, "NDI Output Updated. '%s'", name);
 	obs_log(LOG_DEBUG, "ndi_output_update(name='%s', groups='%s', uses_video='%s', uses_audio='%s')", name, groups,
@@ -283,23 +489,34 @@ void ndi_output_stop(void *data, uint64_t)
 		obs_output_end_data_capture(o->output);
 
 		if (o->ndi_sender) {
-			obs_log(LOG_DEBUG, "ndi_output_stop: +ndiLib->send_destroy(o->ndi_sender)");
+			obs_log(LOG_DEBUG, "ndi_output_stop: +ndi_sender_registry_release(o->ndi_sender)");
 			pthread_mutex_lock(&o->ndi_sender_mutex);
-			ndiLib->send_destroy(o->ndi_sender);
-			obs_log(LOG_DEBUG, "ndi_output_stop: -ndiLib->send_destroy(o->ndi_sender)");
+			// Data capture has ended, so nothing else touches the pending audio frame
+			ndi_output_flush_audio(o);
+			// Stops rendering into the queue before it goes away
+			ndi_source_output_destroy(o->alpha_output);
+			o->alpha_output = nullptr;
+			ndi_send_queue_destroy(o->ndi_send_queue);
+			o->ndi_send_queue = nullptr;
+			ndi_sender_monitor_destroy(o->ndi_sender_monitor);
+			o->ndi_sender_monitor = nullptr;
+			ndi_sender_registry_release(o->ndi_sender, o);
+			obs_log(LOG_DEBUG, "ndi_output_stop: -ndi_sender_registry_release(o->ndi_sender)");
 			o->ndi_sender = nullptr;
 			pthread_mutex_unlock(&o->ndi_sender_mutex);
+			// Nothing downstream can be using a stopped output
+			ndi_output_on_tally(o, false, false);
 		}
 
-		if (o->conv_buffer) {
-			delete[] o->conv_buffer;
-			o->conv_buffer = nullptr;
-			o->conv_function = nullptr;
-		}
+		o->conv_function = nullptr;
+		o->video_planes = 0;
+		o->video_frame_size = 0;
 
 		o->frame_width = 0;
 		o->frame_height = 0;
-		o->video_framerate = 0.0;
+		o->fps_num = 0;
+		o->fps_den = 0;
+		o->video_frame_template = {0};
 		o->audio_channels = 0;
 		o->audio_samplerate = 0;
 
@@ -318,12 +535,6 @@ void ndi_output_destroy(void *data)
 	pthread_mutex_destroy(&o->ndi_sender_mutex);
 
 	obs_log(LOG_DEBUG, "+ndi_output_destroy(name='%s', groups='%s', ...)", name, groups);
-
-	if (o->audio_conv_buffer) {
-		obs_log(LOG_DEBUG, "ndi_output_destroy: freeing %zu bytes", o->audio_conv_buffer_size);
-		bfree(o->audio_conv_buffer);
-		o->audio_conv_buffer = nullptr;
-	}
 	obs_log(LOG_DEBUG, "-ndi_output_destroy(name='%s', groups='%s', ...)", name, groups);
 	bfree(o);
 }
@@ -331,62 +542,47 @@ void ndi_output_destroy(void *data)
 void ndi_output_rawvideo(void *data, video_data *frame)
 {
 	auto o = (ndi_output_t *)data;
-	if (!o->started || !o->frame_width || !o->frame_height)
+	if (!o->started || !o->frame_width || !o->frame_height || !o->ndi_send_queue)
 		return;
 
-	pthread_mutex_lock(&o->ndi_sender_mutex);
-	if (!o->ndi_sender) {
-		pthread_mutex_unlock(&o->ndi_sender_mutex);
+	// Frame rate decimation
+	if (o->frame_count++ % o->frame_divisor != 0)
 		return;
-	}
 
-	// Throttle calls to send_get_no_connections to at most once per second
-	auto now = std::chrono::steady_clock::now();
-	if (now - o->last_conn_check >= std::chrono::seconds(1)) {
-		int nc = ndiLib->send_get_no_connections(o->ndi_sender, 10);
-		o->last_conn_check = now;
-
-		if (nc != o->no_connections) {
-			auto ndi_source = ndiLib->send_get_source_name(o->ndi_sender);
-			if (nc <= 0)
-				obs_log(LOG_DEBUG, "NDI Output video '%s' has no connections.", ndi_source->p_ndi_name);
-			else if (o->no_connections == 0)
-				obs_log(LOG_DEBUG, "NDI Output video '%s' has %d connections.", ndi_source->p_ndi_name,
-					nc);
-			o->no_connections = nc;
-		}
-	}
+	// Idle mode: with no receivers connected, skip conversion and sending
+	// (except for an optional keepalive frame every second).
+	if (!ndi_sender_monitor_should_send(o->ndi_sender_monitor, frame->timestamp, &o->last_video_sent_ns,
+					    o->idle_keepalive ? 1000000000ULL : 0))
+		return;
 
-	pthread_mutex_unlock(&o->ndi_sender_mutex);
+	// Never blocks: if the sender thread is behind, the oldest queued frame is dropped
+	auto slot = ndi_send_queue_acquire_video(o->ndi_send_queue);
+	if (!slot)
+		return;
 
-	uint32_t width = o->frame_width;
-	uint32_t height = o->frame_height;
-
-	NDIlib_video_frame_v2_t video_frame = {0};
-	video_frame.xres = width;
-	video_frame.yres = height;
-	video_frame.frame_rate_N = (int)(o->video_framerate * 100);
-	// TODO fixme: broken on fractional framerates
-	video_frame.frame_rate_D =
-		100; // TODO : investigate if there is a better way to get both _D & _N set to the proper framerate from OBS output.
-	video_frame.frame_format_type = NDIlib_frame_format_type_progressive;
+	slot->frame = o->video_frame_template;
+	slot->frame.p_data = slot->data;
+	slot->capture_ns = frame->timestamp;
 #ifdef SYNC_DEBUG
-	video_frame.timestamp = frame->timestamp / 100;
+	slot->frame.timestamp = frame->timestamp / 100;
 #endif
-	video_frame.timecode = NDIlib_send_timecode_synthesize;
-	video_frame.FourCC = o->frame_fourcc;
 
-	if (video_frame.FourCC == NDIlib_FourCC_type_UYVY) {
-		o->conv_function(frame->data, frame->linesize, 0, height, o->conv_buffer, o->conv_linesize);
-		video_frame.p_data = o->conv_buffer;
-		video_frame.line_stride_in_bytes = o->conv_linesize;
+	if (o->conv_function) {
+		o->conv_function(frame->data, frame->linesize, 0, o->frame_height, slot->data, o->conv_linesize);
 	} else {
-		video_frame.p_data = frame->data[0];
-		video_frame.line_stride_in_bytes = frame->linesize[0];
+		uint8_t *dst = slot->data;
+		for (size_t plane = 0; plane < o->video_planes; ++plane) {
+			uint32_t row_bytes = o->plane_row_bytes[plane];
+			uint32_t src_linesize = frame->linesize[plane];
+			ndi_copy_plane(dst, row_bytes, frame->data[plane], src_linesize,
+				       min_uint32(row_bytes, src_linesize), o->plane_rows[plane]);
+			dst += (size_t)row_bytes * o->plane_rows[plane];
+		}
 	}
-	SYNC_DEBUG_LOG_VIDEO_TIME("NDI <- ndi_output", o->ndi_name, video_frame.timestamp * 100,
-				  (uint8_t *)video_frame.p_data);
-	ndiLib->send_send_video_async_v2(o->ndi_sender, &video_frame);
+
+	SYNC_DEBUG_LOG_VIDEO_TIME("NDI <- ndi_output", o->ndi_name, slot->frame.timestamp * 100,
+				  (uint8_t *)slot->frame.p_data);
+	ndi_send_queue_push_video(o->ndi_send_queue, slot);
 }
 
 void ndi_output_rawaudio(void *data, audio_data *frame)
@@ -394,69 +590,65 @@ void ndi_output_rawaudio(void *data, audio_data *frame)
 	// NOTE: The logic in this function should be similar to
 	// ndi-filter.cpp/ndi_filter_asyncaudio(...)
 	auto o = (ndi_output_t *)data;
-	if (!o->started || !o->audio_samplerate || !o->audio_channels)
+	if (!o->started || !o->audio_samplerate || !o->audio_channels || !o->ndi_send_queue)
 		return;
 
-	pthread_mutex_lock(&o->ndi_sender_mutex);
-	if (!o->ndi_sender) {
-		pthread_mutex_unlock(&o->ndi_sender_mutex);
+	// Nobody is listening: no need to send audio either
+	if (ndi_sender_monitor_get_connections(o->ndi_sender_monitor) == 0) {
+		ndi_output_flush_audio(o);
 		return;
 	}
 
-	auto now = std::chrono::steady_clock::now();
-	if (now - o->last_conn_check >= std::chrono::seconds(1)) {
-		o->last_conn_check = now;
-
-		int nc = ndiLib->send_get_no_connections(o->ndi_sender, 10);
+	// OBS delivers AUDIO_OUTPUT_FRAMES samples per callback. They are appended to a queue slot
+	// holding `audio_frame_samples` samples per channel, which is sent once full.
+	const uint32_t capacity = o->audio_frame_samples;
+	const size_t channel_stride = (size_t)capacity * sizeof(float);
+	const size_t src_stride = (size_t)frame->frames * sizeof(float);
+
+	uint32_t offset = 0;
+	while (offset < frame->frames) {
+		if (!o->audio_pending) {
+			auto slot = ndi_send_queue_acquire_audio(o->ndi_send_queue);
+			if (!slot)
+				return;
+
+			NDIlib_audio_frame_v3_t &audio_frame = slot->frame;
+			audio_frame.sample_rate = o->audio_samplerate;
+			audio_frame.no_channels = (int)o->audio_channels;
+#ifdef SYNC_DEBUG
+			audio_frame.timestamp = frame->timestamp / 100;
+#endif
+			audio_frame.timecode = NDIlib_send_timecode_synthesize;
+			audio_frame.channel_stride_in_bytes = (int)channel_stride;
+			audio_frame.FourCC = NDIlib_FourCC_audio_type_FLTP;
 
-		if (nc != o->no_connections) {
-			auto ndi_source = ndiLib->send_get_source_name(o->ndi_sender);
-			if (nc <= 0)
-				obs_log(LOG_DEBUG, "NDI Output audio '%s' has no connections.", ndi_source->p_ndi_name);
-			else if (o->no_connections == 0)
-				obs_log(LOG_DEBUG, "NDI Output audio '%s' has %d connections.", ndi_source->p_ndi_name,
-					nc);
-			o->no_connections = nc;
+			o->audio_pending = slot;
+			o->audio_pending_samples = 0;
 		}
-	}
 
-	pthread_mutex_unlock(&o->ndi_sender_mutex);
+		uint32_t count = min_uint32(frame->frames - offset, capacity - o->audio_pending_samples);
+		uint8_t *dst = o->audio_pending->data + (size_t)o->audio_pending_samples * sizeof(float);
 
-	NDIlib_audio_frame_v3_t audio_frame = {0};
-	audio_frame.sample_rate = o->audio_samplerate;
-	audio_frame.no_channels = (int)o->audio_channels;
-#ifdef SYNC_DEBUG
-	audio_frame.timestamp = frame->timestamp / 100;
-#endif
-	audio_frame.timecode = NDIlib_send_timecode_synthesize;
-	audio_frame.no_samples = frame->frames;
-	audio_frame.channel_stride_in_bytes = frame->frames * 4;
-	audio_frame.FourCC = NDIlib_FourCC_audio_type_FLTP;
-
-	const size_t data_size = (size_t)audio_frame.no_channels * (size_t)audio_frame.channel_stride_in_bytes;
-
-	if (data_size > o->audio_conv_buffer_size) {
-		obs_log(LOG_DEBUG, "ndi_output_rawaudio('%s'): growing audio_conv_buffer from %zu to %zu bytes",
-			o->ndi_name, o->audio_conv_buffer_size, data_size);
-		if (o->audio_conv_buffer) {
-			obs_log(LOG_DEBUG, "ndi_output_rawaudio('%s'): freeing %zu bytes", o->ndi_name,
-				o->audio_conv_buffer_size);
-			bfree(o->audio_conv_buffer);
+		// OBS's mix buffers are usually one contiguous block of planes: when they also match
+		// the slot layout exactly, all channels are copied at once.
+		bool contiguous = offset == 0 && o->audio_pending_samples == 0 && count == capacity;
+		for (size_t ch = 1; contiguous && ch < o->audio_channels; ++ch)
+			contiguous = frame->data[ch] == frame->data[0] + ch * src_stride;
+
+		if (contiguous) {
+			memcpy(dst, frame->data[0], o->audio_channels * channel_stride);
+		} else {
+			for (size_t ch = 0; ch < o->audio_channels; ++ch)
+				memcpy(dst + ch * channel_stride, frame->data[ch] + (size_t)offset * sizeof(float),
+				       (size_t)count * sizeof(float));
 		}
-		obs_log(LOG_DEBUG, "ndi_output_rawaudio('%s'): allocating %zu bytes", o->ndi_name, data_size);
-		o->audio_conv_buffer = (uint8_t *)bmalloc(data_size);
-		o->audio_conv_buffer_size = data_size;
-	}
 
-	for (int i = 0; i < audio_frame.no_channels; ++i) {
-		memcpy(o->audio_conv_buffer + (i * audio_frame.channel_stride_in_bytes), frame->data[i],
-		       audio_frame.channel_stride_in_bytes);
-	}
+		o->audio_pending_samples += count;
+		offset += count;
 
-	audio_frame.p_data = o->audio_conv_buffer;
-	SYNC_DEBUG_LOG_AUDIO_TIME("NDI <- ndi_output", o->ndi_name, audio_frame.timestamp * 100,
-				  (float *)audio_frame.p_data, audio_frame.no_samples, audio_frame.sample_rate);
-	ndiLib->send_send_audio_v3(o->ndi_sender, &audio_frame);
+		if (o->audio_pending_samples >= capacity)
+			ndi_output_flush_audio(o);
+	}
 }
 
 obs_output_info create_ndi_output_info()
@@ -480,3 +672,18 @@ obs_output_info create_ndi_output_info()
 
 	return ndi_output_info;
 }
+
+// Same output, sending the program rendered with alpha instead of the canvas. Audio only for OBS:
+// without OBS_OUTPUT_VIDEO, no raw video is connected and the canvas frames are not converted.
+obs_output_info create_ndi_alpha_output_info()
+{
+	obs_output_info ndi_alpha_output_info = create_ndi_output_info();
+	ndi_alpha_output_info.id = "ndi_alpha_output";
+	ndi_alpha_output_info.flags = OBS_OUTPUT_AUDIO;
+
+	ndi_alpha_output_info.get_name = ndi_alpha_output_getname;
+
+	ndi_alpha_output_info.raw_video = nullptr;
+
+	return ndi_alpha_output_info;
+}
@@ -0,0 +1,160 @@
+/******************************************************************************
+	Copyright (C) 2016-2024 DistroAV <contact@distroav.org>
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation; either version 2
+	of the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, see <https://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "ndi-readback-cache.h"
+
+#include "plugin-main.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+// How long after the last continuously streamed frame keepalive frames may flush the readback ring
+#define STREAMING_TIMEOUT_NS 1000000000ULL
+
+struct ndi_readback_cache_entry {
+	obs_source_t *content;
+	uint32_t width;
+	uint32_t height;
+	ndi_pixel_format_t requested_format;
+	ndi_pixel_format_t format;
+	long refs;
+
+	gs_texrender_t *texrender;
+	ndi_readback_t *readback;
+	uint64_t staged_frame_time;
+	uint64_t last_streaming_ns;
+
+	// Frame downloaded during the render pass of `downloaded_frame_time`, kept for the other users.
+	// Not filled while there is a single user, which downloads straight into its own buffer.
+	std::vector<uint8_t> frame;
+	bool frame_valid;
+	uint64_t frame_timestamp;
+	uint64_t downloaded_frame_time;
+};
+
+// Graphics thread only
+static std::vector<ndi_readback_cache_entry_t *> entries;
+
+ndi_readback_cache_entry_t *ndi_readback_cache_acquire(obs_source_t *content, uint32_t width, uint32_t height,
+						       ndi_pixel_format_t format, const char *log_name)
+{
+	for (auto entry : entries) {
+		if (ndi_readback_cache_matches(entry, content, width, height, format)) {
+			entry->refs++;
+			obs_log(LOG_DEBUG, "ndi_readback_cache_acquire('%s'): sharing readback, %ld users", log_name,
+				entry->refs);
+			return entry;
+		}
+	}
+
+	auto entry = new ndi_readback_cache_entry_t();
+	entry->content = content;
+	entry->width = width;
+	entry->height = height;
+	entry->requested_format = format;
+	entry->refs = 1;
+	entry->texrender = gs_texrender_create(GS_BGRA, GS_ZS_NONE);
+	entry->readback = ndi_readback_create(log_name, Config::ReadbackDepth);
+	entry->format = ndi_readback_effective_format(entry->readback, format, width);
+	entries.push_back(entry);
+	return entry;
+}
+
+void ndi_readback_cache_release(ndi_readback_cache_entry_t *entry)
+{
+	if (!entry || --entry->refs > 0)
+		return;
+
+	entries.erase(std::remove(entries.begin(), entries.end(), entry), entries.end());
+	ndi_readback_destroy(entry->readback);
+	gs_texrender_destroy(entry->texrender);
+	delete entry;
+}
+
+bool ndi_readback_cache_matches(const ndi_readback_cache_entry_t *entry, obs_source_t *content, uint32_t width,
+				uint32_t height, ndi_pixel_format_t format)
+{
+	return entry && entry->content == content && entry->width == width && entry->height == height &&
+	       entry->requested_format == format;
+}
+
+ndi_pixel_format_t ndi_readback_cache_format(const ndi_readback_cache_entry_t *entry)
+{
+	return entry->format;
+}
+
+gs_texrender_t *ndi_readback_cache_begin(ndi_readback_cache_entry_t *entry, uint64_t frame_time)
+{
+	if (entry->staged_frame_time == frame_time)
+		return nullptr;
+
+	// Set right away: the content may render another user of the entry, e.g. a filter rendering
+	// its target, which must not begin the texrender that is being rendered into.
+	entry->staged_frame_time = frame_time;
+	gs_texrender_reset(entry->texrender);
+	return entry->texrender;
+}
+
+void ndi_readback_cache_stage(ndi_readback_cache_entry_t *entry, uint64_t timestamp, bool keepalive)
+{
+	if (!ndi_readback_stage(entry->readback, gs_texrender_get_texture(entry->texrender), entry->width,
+				entry->height, entry->format, timestamp))
+		return;
+
+	if (!keepalive)
+		entry->last_streaming_ns = timestamp;
+	else if (timestamp - entry->last_streaming_ns >= STREAMING_TIMEOUT_NS)
+		ndi_readback_flush(entry->readback);
+}
+
+bool ndi_readback_cache_ready(const ndi_readback_cache_entry_t *entry, uint64_t frame_time, uint64_t *timestamp)
+{
+	if (entry->downloaded_frame_time == frame_time) {
+		if (timestamp)
+			*timestamp = entry->frame_timestamp;
+		return entry->frame_valid;
+	}
+
+	return ndi_readback_ready(entry->readback, timestamp);
+}
+
+bool ndi_readback_cache_download(ndi_readback_cache_entry_t *entry, uint64_t frame_time, uint8_t *dst)
+{
+	uint32_t linesize = ndi_readback_linesize(entry->format, entry->width);
+	size_t size = ndi_readback_frame_size(entry->format, entry->width, entry->height);
+
+	if (entry->downloaded_frame_time != frame_time) {
+		if (!ndi_readback_ready(entry->readback, &entry->frame_timestamp))
+			return false;
+		entry->downloaded_frame_time = frame_time;
+
+		if (entry->refs == 1) {
+			entry->frame_valid = false;
+			return ndi_readback_download(entry->readback, dst, linesize);
+		}
+
+		entry->frame.resize(size);
+		entry->frame_valid = ndi_readback_download(entry->readback, entry->frame.data(), linesize);
+	}
+
+	if (!entry->frame_valid)
+		return false;
+
+	memcpy(dst, entry->frame.data(), size);
+	return true;
+}
@@ -0,0 +1,63 @@
+/******************************************************************************
+	Copyright (C) 2016-2024 DistroAV <contact@distroav.org>
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation; either version 2
+	of the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, see <https://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ndi-readback.h"
+
+/**
+ * Readbacks shared by the senders that send the same pixels, e.g. two NDI filters stacked
+ * on the same source: the content is rendered, staged and mapped once per frame, and the
+ * other users of the frame get a copy of the downloaded data.
+ *
+ * Entries are keyed by the source that is rendered, the size and the requested pixel
+ * format, and a frame is identified by the OBS video frame time of the render pass.
+ *
+ * All functions must be called in the graphics context.
+ */
+typedef struct ndi_readback_cache_entry ndi_readback_cache_entry_t;
+
+// Takes a reference on the entry for `content` (which is only used as a key).
+ndi_readback_cache_entry_t *ndi_readback_cache_acquire(obs_source_t *content, uint32_t width, uint32_t height,
+						       ndi_pixel_format_t format, const char *log_name);
+void ndi_readback_cache_release(ndi_readback_cache_entry_t *entry);
+
+bool ndi_readback_cache_matches(const ndi_readback_cache_entry_t *entry, obs_source_t *content, uint32_t width,
+				uint32_t height, ndi_pixel_format_t format);
+
+// Pixel format actually produced, see ndi_readback_effective_format.
+ndi_pixel_format_t ndi_readback_cache_format(const ndi_readback_cache_entry_t *entry);
+
+// Null if the frame of `frame_time` was already staged by another user. Otherwise, the caller
+// renders the content into the returned texrender and calls ndi_readback_cache_stage.
+gs_texrender_t *ndi_readback_cache_begin(ndi_readback_cache_entry_t *entry, uint64_t frame_time);
+
+// Stages what was rendered into the texrender, `timestamp` being handed back with the frame by
+// ndi_readback_cache_ready (the OBS video frame time for the filters). A `keepalive` frame (sent
+// while nobody is connected) is read back right away, unless another user of the entry streams
+// continuously.
+void ndi_readback_cache_stage(ndi_readback_cache_entry_t *entry, uint64_t timestamp, bool keepalive);
+
+// True if a downloaded frame is available during the render pass of `frame_time`.
+bool ndi_readback_cache_ready(const ndi_readback_cache_entry_t *entry, uint64_t frame_time, uint64_t *timestamp);
+
+// Copies that frame to `dst`, which must hold a tightly packed frame (ndi_readback_frame_size).
+// Each user gets the frame once per render pass; the first one downloads it from the GPU.
+bool ndi_readback_cache_download(ndi_readback_cache_entry_t *entry, uint64_t frame_time, uint8_t *dst);
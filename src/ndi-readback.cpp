@@ -0,0 +1,382 @@
+/******************************************************************************
+	Copyright (C) 2016-2024 DistroAV <contact@distroav.org>
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation; either version 2
+	of the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, see <https://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "ndi-readback.h"
+#include "ndi-copy.h"
+
+#include "plugin-main.h"
+
+#include <util/platform.h>
+
+// Render thread timings are logged (at debug level) every this many staged frames
+#define NDI_READBACK_STATS_FRAMES 600
+
+struct ndi_readback_slot {
+	gs_stagesurf_t *stagesurface;
+	gs_stagesurf_t *alpha_stagesurface;
+	uint64_t timestamp;
+};
+
+struct ndi_readback {
+	char *log_name;
+
+	gs_effect_t *effect;
+	gs_eparam_t *param_image;
+	gs_eparam_t *param_size;
+	gs_eparam_t *param_color_vec_y;
+	gs_eparam_t *param_color_vec_u;
+	gs_eparam_t *param_color_vec_v;
+
+	gs_texrender_t *uyvy_render;
+	gs_texrender_t *alpha_render;
+
+	// Ring of staging surfaces: `pending` frames were staged and not downloaded yet,
+	// the newest one in the slot before `next`.
+	ndi_readback_slot slots[NDI_READBACK_DEPTH_MAX];
+	uint32_t depth;
+	uint32_t next;
+	uint32_t pending;
+	// Set by ndi_readback_flush: the pending frame is ready although the ring is not full
+	bool flushed;
+
+	// Layout of the staging surfaces
+	ndi_pixel_format_t format;
+	uint32_t width;
+	uint32_t height;
+
+	// Render thread time spent since the stats were last logged
+	uint64_t stats_frames;
+	uint64_t stats_downloads;
+	uint64_t stats_dropped;
+	uint64_t stats_stage_ns;
+	uint64_t stats_download_ns;
+	uint64_t stats_download_max_ns;
+};
+
+ndi_readback_t *ndi_readback_create(const char *log_name, uint32_t depth)
+{
+	auto rb = (ndi_readback_t *)bzalloc(sizeof(ndi_readback_t));
+	rb->log_name = bstrdup(log_name ? log_name : "");
+	if (depth == 0)
+		depth = NDI_READBACK_DEPTH_DEFAULT;
+	rb->depth = depth > NDI_READBACK_DEPTH_MAX ? NDI_READBACK_DEPTH_MAX : depth;
+
+	char *path = obs_module_file("ndi_pack.effect");
+	if (path) {
+		char *errors = nullptr;
+		rb->effect = gs_effect_create_from_file(path, &errors);
+		if (!rb->effect)
+			obs_log(LOG_WARNING, "ndi_readback_create: failed to load '%s': %s", path,
+				errors ? errors : "unknown error");
+		bfree(errors);
+		bfree(path);
+	}
+
+	if (rb->effect) {
+		rb->param_image = gs_effect_get_param_by_name(rb->effect, "image");
+		rb->param_size = gs_effect_get_param_by_name(rb->effect, "size");
+		rb->param_color_vec_y = gs_effect_get_param_by_name(rb->effect, "color_vec_y");
+		rb->param_color_vec_u = gs_effect_get_param_by_name(rb->effect, "color_vec_u");
+		rb->param_color_vec_v = gs_effect_get_param_by_name(rb->effect, "color_vec_v");
+		rb->uyvy_render = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+		rb->alpha_render = gs_texrender_create(GS_R8, GS_ZS_NONE);
+	} else {
+		obs_log(LOG_WARNING, "ndi_readback_create: GPU packing unavailable, frames are sent as BGRA");
+	}
+
+	obs_log(LOG_DEBUG, "ndi_readback_create('%s'): %u staging surfaces", rb->log_name, rb->depth);
+	return rb;
+}
+
+static void ndi_readback_reset_slots(ndi_readback_t *rb)
+{
+	for (auto &slot : rb->slots) {
+		gs_stagesurface_destroy(slot.stagesurface);
+		gs_stagesurface_destroy(slot.alpha_stagesurface);
+		slot.stagesurface = nullptr;
+		slot.alpha_stagesurface = nullptr;
+	}
+	rb->next = 0;
+	rb->pending = 0;
+}
+
+static void ndi_readback_log_stats(ndi_readback_t *rb)
+{
+	if (!rb->stats_frames)
+		return;
+
+	obs_log(LOG_DEBUG,
+		"ndi_readback('%s'): depth %u, %llu frames: stage avg %.3f ms, map+copy avg %.3f ms max %.3f ms, "
+		"%llu dropped",
+		rb->log_name, rb->depth, (unsigned long long)rb->stats_frames,
+		(double)rb->stats_stage_ns / (double)rb->stats_frames / 1000000.0,
+		rb->stats_downloads ? (double)rb->stats_download_ns / (double)rb->stats_downloads / 1000000.0 : 0.0,
+		(double)rb->stats_download_max_ns / 1000000.0, (unsigned long long)rb->stats_dropped);
+
+	rb->stats_frames = 0;
+	rb->stats_downloads = 0;
+	rb->stats_dropped = 0;
+	rb->stats_stage_ns = 0;
+	rb->stats_download_ns = 0;
+	rb->stats_download_max_ns = 0;
+}
+
+void ndi_readback_destroy(ndi_readback_t *readback)
+{
+	if (!readback)
+		return;
+
+	ndi_readback_log_stats(readback);
+	ndi_readback_reset_slots(readback);
+	gs_texrender_destroy(readback->uyvy_render);
+	gs_texrender_destroy(readback->alpha_render);
+	gs_effect_destroy(readback->effect);
+	bfree(readback->log_name);
+	bfree(readback);
+}
+
+ndi_pixel_format_t ndi_readback_effective_format(const ndi_readback_t *readback, ndi_pixel_format_t format,
+						 uint32_t width)
+{
+	if (format == NDI_PIXEL_FORMAT_BGRA || !readback || !readback->effect || (width & 1))
+		return NDI_PIXEL_FORMAT_BGRA;
+	return format;
+}
+
+NDIlib_FourCC_video_type_e ndi_readback_fourcc(ndi_pixel_format_t format)
+{
+	switch (format) {
+	case NDI_PIXEL_FORMAT_UYVY:
+		return NDIlib_FourCC_video_type_UYVY;
+	case NDI_PIXEL_FORMAT_UYVA:
+		return NDIlib_FourCC_video_type_UYVA;
+	default:
+		return NDIlib_FourCC_video_type_BGRA;
+	}
+}
+
+uint32_t ndi_readback_linesize(ndi_pixel_format_t format, uint32_t width)
+{
+	return format == NDI_PIXEL_FORMAT_BGRA ? width * 4 : width * 2;
+}
+
+size_t ndi_readback_frame_size(ndi_pixel_format_t format, uint32_t width, uint32_t height)
+{
+	size_t size = (size_t)ndi_readback_linesize(format, width) * height;
+	if (format == NDI_PIXEL_FORMAT_UYVA)
+		size += (size_t)width * height;
+	return size;
+}
+
+// RGB to limited range Y'CbCr, with the matrix NDI receivers assume for the frame size
+static void ndi_readback_set_color_params(ndi_readback_t *rb, uint32_t height)
+{
+	const bool hd = height >= 720;
+	const float kr = hd ? 0.2126f : 0.299f;
+	const float kb = hd ? 0.0722f : 0.114f;
+	const float kg = 1.0f - kr - kb;
+
+	const float y_scale = 219.0f / 255.0f;
+	const float u_scale = 224.0f / 255.0f / (2.0f * (1.0f - kb));
+	const float v_scale = 224.0f / 255.0f / (2.0f * (1.0f - kr));
+
+	vec4 color_vec_y, color_vec_u, color_vec_v;
+	vec4_set(&color_vec_y, kr * y_scale, kg * y_scale, kb * y_scale, 16.0f / 255.0f);
+	vec4_set(&color_vec_u, -kr * u_scale, -kg * u_scale, (1.0f - kb) * u_scale, 128.0f / 255.0f);
+	vec4_set(&color_vec_v, (1.0f - kr) * v_scale, -kg * v_scale, -kb * v_scale, 128.0f / 255.0f);
+
+	gs_effect_set_vec4(rb->param_color_vec_y, &color_vec_y);
+	gs_effect_set_vec4(rb->param_color_vec_u, &color_vec_u);
+	gs_effect_set_vec4(rb->param_color_vec_v, &color_vec_v);
+}
+
+static gs_texture_t *ndi_readback_pack(ndi_readback_t *rb, gs_texrender_t *render, const char *technique,
+				       gs_texture_t *texture, uint32_t out_width, uint32_t out_height)
+{
+	gs_texrender_reset(render);
+	if (!gs_texrender_begin(render, out_width, out_height))
+		return nullptr;
+
+	vec2 size;
+	vec2_set(&size, (float)rb->width, (float)rb->height);
+
+	gs_ortho(0.0f, (float)out_width, 0.0f, (float)out_height, -100.0f, 100.0f);
+	gs_effect_set_texture(rb->param_image, texture);
+	gs_effect_set_vec2(rb->param_size, &size);
+
+	while (gs_effect_loop(rb->effect, technique))
+		gs_draw_sprite(texture, 0, out_width, out_height);
+
+	gs_texrender_end(render);
+	return gs_texrender_get_texture(render);
+}
+
+static bool ndi_readback_stage_slot(ndi_readback_t *rb, ndi_readback_slot *slot, gs_texture_t *texture)
+{
+	const uint32_t width = rb->width;
+	const uint32_t height = rb->height;
+	const ndi_pixel_format_t format = rb->format;
+
+	if (!slot->stagesurface) {
+		if (format == NDI_PIXEL_FORMAT_BGRA) {
+			slot->stagesurface = gs_stagesurface_create(width, height, GS_BGRA);
+		} else {
+			slot->stagesurface = gs_stagesurface_create(width / 2, height, GS_RGBA);
+			if (format == NDI_PIXEL_FORMAT_UYVA)
+				slot->alpha_stagesurface = gs_stagesurface_create(width, height, GS_R8);
+		}
+		if (!slot->stagesurface || (format == NDI_PIXEL_FORMAT_UYVA && !slot->alpha_stagesurface))
+			return false;
+	}
+
+	if (format == NDI_PIXEL_FORMAT_BGRA) {
+		gs_stage_texture(slot->stagesurface, texture);
+		return true;
+	}
+
+	gs_blend_state_push();
+	gs_enable_blending(false);
+	const bool previous_srgb = gs_framebuffer_srgb_enabled();
+	gs_enable_framebuffer_srgb(false);
+
+	ndi_readback_set_color_params(rb, height);
+
+	gs_texture_t *uyvy = ndi_readback_pack(rb, rb->uyvy_render, "PackUYVY", texture, width / 2, height);
+	gs_texture_t *alpha = nullptr;
+	if (uyvy && format == NDI_PIXEL_FORMAT_UYVA)
+		alpha = ndi_readback_pack(rb, rb->alpha_render, "PackAlpha", texture, width, height);
+
+	gs_enable_framebuffer_srgb(previous_srgb);
+	gs_blend_state_pop();
+
+	if (!uyvy || (format == NDI_PIXEL_FORMAT_UYVA && !alpha))
+		return false;
+
+	gs_stage_texture(slot->stagesurface, uyvy);
+	if (alpha)
+		gs_stage_texture(slot->alpha_stagesurface, alpha);
+	return true;
+}
+
+bool ndi_readback_stage(ndi_readback_t *readback, gs_texture_t *texture, uint32_t width, uint32_t height,
+			ndi_pixel_format_t format, uint64_t timestamp)
+{
+	auto rb = readback;
+	if (!rb || !texture || !width || !height)
+		return false;
+
+	const uint64_t start_ns = os_gettime_ns();
+
+	format = ndi_readback_effective_format(rb, format, width);
+
+	if (rb->format != format || rb->width != width || rb->height != height) {
+		// Frames staged with the previous layout cannot be downloaded anymore
+		ndi_readback_reset_slots(rb);
+		rb->format = format;
+		rb->width = width;
+		rb->height = height;
+	}
+
+	if (rb->pending == rb->depth) {
+		// The oldest frame was never downloaded, its slot is about to be reused
+		rb->pending--;
+		rb->stats_dropped++;
+	}
+
+	ndi_readback_slot *slot = &rb->slots[rb->next];
+	if (!ndi_readback_stage_slot(rb, slot, texture))
+		return false;
+
+	slot->timestamp = timestamp;
+	rb->next = (rb->next + 1) % rb->depth;
+	rb->pending++;
+	rb->flushed = false;
+
+	rb->stats_stage_ns += os_gettime_ns() - start_ns;
+	if (++rb->stats_frames >= NDI_READBACK_STATS_FRAMES)
+		ndi_readback_log_stats(rb);
+
+	return true;
+}
+
+bool ndi_readback_ready(const ndi_readback_t *readback, uint64_t *timestamp)
+{
+	auto rb = readback;
+	if (!rb || !rb->pending || (rb->pending < rb->depth && !rb->flushed))
+		return false;
+
+	if (timestamp)
+		*timestamp = rb->slots[(rb->next + rb->depth - rb->pending) % rb->depth].timestamp;
+	return true;
+}
+
+static bool ndi_readback_copy_plane(gs_stagesurf_t *surface, uint8_t *dst, uint32_t dst_linesize,
+				    uint32_t row_bytes, uint32_t rows)
+{
+	uint8_t *src;
+	uint32_t src_linesize;
+	if (!gs_stagesurface_map(surface, &src, &src_linesize))
+		return false;
+
+	ndi_copy_plane(dst, dst_linesize, src, src_linesize, row_bytes, rows);
+
+	gs_stagesurface_unmap(surface);
+	return true;
+}
+
+void ndi_readback_flush(ndi_readback_t *readback)
+{
+	auto rb = readback;
+	if (!rb || !rb->pending)
+		return;
+
+	rb->stats_dropped += rb->pending - 1;
+	rb->pending = 1;
+	rb->flushed = true;
+}
+
+bool ndi_readback_download(ndi_readback_t *readback, uint8_t *dst, uint32_t dst_linesize)
+{
+	auto rb = readback;
+	if (!ndi_readback_ready(rb, nullptr))
+		return false;
+
+	uint32_t row_bytes = ndi_readback_linesize(rb->format, rb->width);
+	if (dst_linesize < row_bytes)
+		return false;
+
+	const uint64_t start_ns = os_gettime_ns();
+
+	// The slot is released whether or not mapping succeeds, a failed frame is not retried
+	ndi_readback_slot *slot = &rb->slots[(rb->next + rb->depth - rb->pending) % rb->depth];
+	rb->pending--;
+
+	bool success = ndi_readback_copy_plane(slot->stagesurface, dst, dst_linesize, row_bytes, rb->height);
+	if (success && rb->format == NDI_PIXEL_FORMAT_UYVA) {
+		uint8_t *alpha_dst = dst + (size_t)dst_linesize * rb->height;
+		success = ndi_readback_copy_plane(slot->alpha_stagesurface, alpha_dst, rb->width, rb->width,
+						  rb->height);
+	}
+
+	const uint64_t elapsed_ns = os_gettime_ns() - start_ns;
+	rb->stats_downloads++;
+	rb->stats_download_ns += elapsed_ns;
+	if (elapsed_ns > rb->stats_download_max_ns)
+		rb->stats_download_max_ns = elapsed_ns;
+
+	return success;
+}
@@ -0,0 +1,85 @@
+/******************************************************************************
+	Copyright (C) 2016-2024 DistroAV <contact@distroav.org>
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation; either version 2
+	of the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, see <https://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <Processing.NDI.Lib.h>
+
+#include <obs-module.h>
+
+/**
+ * GPU to CPU readback of rendered frames, in the pixel format that is sent over NDI.
+ *
+ * UYVY and UYVA are packed on the GPU before staging, which halves (UYVY) or cuts by
+ * a quarter (UYVA) the amount of data read back compared to BGRA, and spares the NDI
+ * encoder its own color conversion. Colors are converted with BT.601 for SD and BT.709
+ * for HD sizes in limited range, which is what NDI receivers assume for UYVY.
+ *
+ * Frames are staged into a ring of `depth` staging surfaces and only mapped once the ring is
+ * full, i.e. frame N-(depth-1) is downloaded right after frame N was staged. By then the GPU
+ * has long finished copying it, so mapping does not stall the render thread waiting for the
+ * copy, at the cost of (depth-1) frames of latency. A depth of 1 maps synchronously.
+ *
+ * Creating, destroying, staging and downloading must happen in the graphics context.
+ */
+typedef struct ndi_readback ndi_readback_t;
+
+#define NDI_READBACK_DEPTH_DEFAULT 3
+#define NDI_READBACK_DEPTH_MAX 4
+
+typedef enum ndi_pixel_format {
+	NDI_PIXEL_FORMAT_BGRA = 0,
+	NDI_PIXEL_FORMAT_UYVY = 1, // 4:2:2, no alpha
+	NDI_PIXEL_FORMAT_UYVA = 2, // UYVY followed by an 8-bit alpha plane
+} ndi_pixel_format_t;
+
+// `depth` is clamped to 1..NDI_READBACK_DEPTH_MAX, 0 selects NDI_READBACK_DEPTH_DEFAULT.
+// `log_name` is only used for logging.
+ndi_readback_t *ndi_readback_create(const char *log_name, uint32_t depth);
+void ndi_readback_destroy(ndi_readback_t *readback);
+
+// Pixel format actually produced for `format`: BGRA if the frame width is odd (packed formats
+// need an even width) or if the packing effect could not be loaded.
+ndi_pixel_format_t ndi_readback_effective_format(const ndi_readback_t *readback, ndi_pixel_format_t format,
+						 uint32_t width);
+
+NDIlib_FourCC_video_type_e ndi_readback_fourcc(ndi_pixel_format_t format);
+
+// Bytes per row of the first plane, and for a whole tightly packed frame (all planes).
+uint32_t ndi_readback_linesize(ndi_pixel_format_t format, uint32_t width);
+size_t ndi_readback_frame_size(ndi_pixel_format_t format, uint32_t width, uint32_t height);
+
+// Converts `texture` (BGRA, `width` x `height`) to `format` on the GPU and copies it to the next
+// staging surface of the ring. If the oldest staged frame was never downloaded it is dropped.
+// Changing the size or format discards all frames staged with the previous layout.
+bool ndi_readback_stage(ndi_readback_t *readback, gs_texture_t *texture, uint32_t width, uint32_t height,
+			ndi_pixel_format_t format, uint64_t timestamp);
+
+// True if a staged frame is old enough to be downloaded; `timestamp` receives the value it was
+// staged with. The frame has the size and format of the last call to ndi_readback_stage.
+bool ndi_readback_ready(const ndi_readback_t *readback, uint64_t *timestamp);
+
+// Drops all staged frames but the newest and makes it ready right away: downloading it then waits
+// for its copy to complete. For senders that only want an occasional frame, e.g. a keepalive.
+void ndi_readback_flush(ndi_readback_t *readback);
+
+// Maps the oldest ready frame and copies it to `dst`, rows of the first plane being `dst_linesize`
+// bytes apart. For UYVA the alpha plane follows the first plane, with rows `width` bytes apart.
+bool ndi_readback_download(ndi_readback_t *readback, uint8_t *dst, uint32_t dst_linesize);
@@ -0,0 +1,516 @@
+/******************************************************************************
+	Copyright (C) 2016-2024 DistroAV <contact@distroav.org>
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation; either version 2
+	of the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, see <https://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "ndi-send-queue.h"
+
+#include "plugin-main.h"
+
+#include <util/threading.h>
+#include <util/platform.h>
+#include <util/util_uint64.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Paced mode: frames kept queued before sending starts, absorbing OBS's frame timing jitter
+#define PACING_PREBUFFER_FRAMES 2
+// Paced mode: a frame later than this many intervals restarts the schedule instead of bursting
+#define PACING_MAX_LATE_FRAMES 2
+// Longer gaps between sends (idle senders, underruns) are not counted as jitter
+#define JITTER_MAX_GAP_FRAMES 4
+
+// Bounded ring of slot pointers.
+// Only one thread may push, but popping is done with a CAS on the read index so that
+// the producer can also pop the oldest entry (drop-oldest) while the consumer pops.
+template<typename T> class slot_ring {
+public:
+	explicit slot_ring(size_t capacity) : slots(capacity ? capacity : 1) {}
+
+	bool push(T *slot)
+	{
+		size_t tail = write_index.load(std::memory_order_relaxed);
+		size_t head = read_index.load(std::memory_order_acquire);
+		if (tail - head >= slots.size())
+			return false;
+
+		slots[tail % slots.size()].store(slot, std::memory_order_relaxed);
+		write_index.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	T *pop()
+	{
+		size_t head = read_index.load(std::memory_order_acquire);
+		for (;;) {
+			size_t tail = write_index.load(std::memory_order_acquire);
+			if (head == tail)
+				return nullptr;
+
+			T *slot = slots[head % slots.size()].load(std::memory_order_relaxed);
+			if (read_index.compare_exchange_weak(head, head + 1, std::memory_order_acq_rel,
+							     std::memory_order_acquire))
+				return slot;
+		}
+	}
+
+	size_t capacity() const { return slots.size(); }
+
+	size_t size() const
+	{
+		return write_index.load(std::memory_order_acquire) - read_index.load(std::memory_order_acquire);
+	}
+
+private:
+	std::vector<std::atomic<T *>> slots;
+	std::atomic<size_t> read_index{0};
+	std::atomic<size_t> write_index{0};
+};
+
+template<typename T> struct slot_stream {
+	std::vector<T> storage;
+	slot_ring<T> *ready = nullptr; // producer -> sender thread
+	slot_ring<T> *free = nullptr;  // sender thread -> producer
+
+	std::atomic<uint64_t> sent{0};
+	std::atomic<uint64_t> dropped{0};
+	std::atomic<size_t> max_depth{0};
+
+	void init(size_t frame_size, size_t depth, size_t held_by_sender)
+	{
+		if (!frame_size || !depth)
+			return;
+
+		// `depth` slots may be queued while the sender thread holds `held_by_sender`
+		// more, so the producer can always get a slot by dropping the oldest frame.
+		storage.resize(depth + held_by_sender);
+		ready = new slot_ring<T>(depth);
+		free = new slot_ring<T>(storage.size());
+		for (auto &slot : storage) {
+			slot.data = (uint8_t *)bmalloc(frame_size);
+			slot.size = frame_size;
+			free->push(&slot);
+		}
+	}
+
+	void release()
+	{
+		for (auto &slot : storage)
+			bfree(slot.data);
+		storage.clear();
+		delete ready;
+		delete free;
+		ready = nullptr;
+		free = nullptr;
+	}
+
+	T *acquire()
+	{
+		if (!free)
+			return nullptr;
+
+		T *slot = nullptr;
+
+		// Queue full: drop the oldest frame and reuse its slot. This also guarantees
+		// that the following push() has room, as only the sender thread pops meanwhile.
+		if (ready->size() >= ready->capacity()) {
+			slot = ready->pop();
+			if (slot)
+				dropped++;
+		}
+		if (!slot)
+			slot = free->pop();
+		if (!slot) {
+			slot = ready->pop();
+			dropped++;
+		}
+		if (slot)
+			slot->frame.p_data = slot->data;
+		return slot;
+	}
+
+	void push(T *slot)
+	{
+		ready->push(slot);
+
+		size_t depth = ready->size();
+		size_t max = max_depth.load(std::memory_order_relaxed);
+		while (depth > max && !max_depth.compare_exchange_weak(max, depth, std::memory_order_relaxed))
+			;
+	}
+};
+
+struct ndi_send_queue {
+	NDIlib_send_instance_t sender;
+	std::string log_name;
+
+	slot_stream<ndi_video_slot_t> video;
+	slot_stream<ndi_audio_slot_t> audio;
+
+	// Set once before video frames are pushed
+	std::atomic<uint32_t> fps_num{0};
+	std::atomic<uint32_t> fps_den{0};
+	std::atomic<bool> paced{false};
+
+	std::atomic<uint64_t> jitter_total_ns{0};
+	std::atomic<uint64_t> jitter_samples{0};
+	std::atomic<uint64_t> jitter_max_ns{0};
+	std::atomic<uint64_t> underruns{0};
+
+	std::atomic<uint64_t> latency_total_ns{0};
+	std::atomic<uint64_t> latency_samples{0};
+	std::atomic<uint64_t> latency_max_ns{0};
+
+	std::atomic<uint64_t> send_total_ns{0};
+	std::atomic<uint64_t> send_max_ns{0};
+
+	pthread_t thread;
+	os_event_t *frame_event;
+	std::atomic<bool> stopping{false};
+};
+
+// State of the sender thread's video sends
+struct video_send_state {
+	ndi_video_slot_t *in_flight = nullptr;
+	uint64_t last_send_ns = 0;
+
+	// Paced mode schedule: frame `frame_index` is due at start_ns + frame_index * interval
+	bool running = false;
+	uint64_t start_ns = 0;
+	uint64_t frame_index = 0;
+	uint64_t waiting_since_ns = 0;
+};
+
+static void ndi_send_queue_log_stats(ndi_send_queue_t *q, int log_level)
+{
+	ndi_send_queue_stats_t stats;
+	ndi_send_queue_get_stats(q, &stats);
+	obs_log(log_level,
+		"NDI send queue '%s': video sent=%llu dropped=%llu max_depth=%zu, audio sent=%llu dropped=%llu max_depth=%zu",
+		q->log_name.c_str(), (unsigned long long)stats.video_sent, (unsigned long long)stats.video_dropped,
+		stats.video_max_depth, (unsigned long long)stats.audio_sent, (unsigned long long)stats.audio_dropped,
+		stats.audio_max_depth);
+	if (q->fps_num.load())
+		obs_log(log_level, "NDI send queue '%s': %s video, send jitter avg=%.2fms max=%.2fms, underruns=%llu",
+			q->log_name.c_str(), q->paced.load() ? "paced" : "unpaced",
+			stats.video_jitter_avg_ns / 1000000.0, stats.video_jitter_max_ns / 1000000.0,
+			(unsigned long long)stats.video_underruns);
+	if (q->latency_samples.load())
+		obs_log(log_level, "NDI send queue '%s': render to send latency avg=%.2fms max=%.2fms",
+			q->log_name.c_str(), stats.video_latency_avg_ns / 1000000.0,
+			stats.video_latency_max_ns / 1000000.0);
+	if (stats.video_sent)
+		obs_log(log_level, "NDI send queue '%s': video send call avg=%.2fms max=%.2fms", q->log_name.c_str(),
+			stats.video_send_avg_ns / 1000000.0, stats.video_send_max_ns / 1000000.0);
+}
+
+static void ndi_send_queue_send_video(ndi_send_queue_t *q, video_send_state &state, ndi_video_slot_t *slot,
+				      uint64_t now)
+{
+	// Video is sent asynchronously: NDI keeps using the last submitted buffer until the
+	// next video send, so that slot is only handed back to the producer afterwards.
+	ndiLib->send_send_video_async_v2(q->sender, &slot->frame);
+	uint64_t send_ns = os_gettime_ns() - now;
+	q->send_total_ns += send_ns;
+	if (send_ns > q->send_max_ns.load())
+		q->send_max_ns = send_ns;
+	if (state.in_flight)
+		q->video.free->push(state.in_flight);
+	state.in_flight = slot;
+	q->video.sent++;
+
+	uint32_t fps_num = q->fps_num.load();
+	uint32_t fps_den = q->fps_den.load();
+	if (fps_num && fps_den && state.last_send_ns) {
+		uint64_t interval = util_mul_div64(fps_den, 1000000000ULL, fps_num);
+		uint64_t elapsed = now - state.last_send_ns;
+		if (elapsed <= interval * JITTER_MAX_GAP_FRAMES) {
+			uint64_t jitter = elapsed > interval ? elapsed - interval : interval - elapsed;
+			q->jitter_total_ns += jitter;
+			q->jitter_samples++;
+			if (jitter > q->jitter_max_ns.load())
+				q->jitter_max_ns = jitter;
+		}
+	}
+	state.last_send_ns = now;
+
+	if (slot->capture_ns && now > slot->capture_ns) {
+		uint64_t latency = now - slot->capture_ns;
+		q->latency_total_ns += latency;
+		q->latency_samples++;
+		if (latency > q->latency_max_ns.load())
+			q->latency_max_ns = latency;
+	}
+}
+
+// Sends the queued video frames that are due and returns how long to wait for the next one (in ns)
+static uint64_t ndi_send_queue_pace_video(ndi_send_queue_t *q, video_send_state &state, bool stopping)
+{
+	const uint64_t idle_wait = 1000000000ULL;
+	uint32_t fps_num = q->fps_num.load();
+	uint32_t fps_den = q->fps_den.load();
+	uint64_t interval = util_mul_div64(fps_den, 1000000000ULL, fps_num);
+	uint64_t now = os_gettime_ns();
+
+	if (!state.running) {
+		size_t depth = q->video.ready->size();
+		if (depth == 0) {
+			state.waiting_since_ns = 0;
+			return idle_wait;
+		}
+		if (!state.waiting_since_ns)
+			state.waiting_since_ns = now;
+
+		// Fill the jitter buffer first, but do not hold back frames from a sender that is
+		// only sending a few (idle keepalive) for longer than the buffer would last.
+		uint64_t prebuffer_ns = interval * PACING_PREBUFFER_FRAMES;
+		if (depth < PACING_PREBUFFER_FRAMES && now - state.waiting_since_ns < prebuffer_ns && !stopping)
+			return state.waiting_since_ns + prebuffer_ns - now;
+
+		state.running = true;
+		state.start_ns = now;
+		state.frame_index = 0;
+		state.waiting_since_ns = 0;
+	}
+
+	for (;;) {
+		uint64_t deadline = state.start_ns +
+				    util_mul_div64(state.frame_index, fps_den * 1000000000ULL, fps_num);
+		now = os_gettime_ns();
+		if (now < deadline && !stopping)
+			return deadline - now;
+
+		auto slot = q->video.ready->pop();
+		if (!slot) {
+			// Jitter buffer ran dry: refill it before sending again
+			if (!stopping)
+				q->underruns++;
+			state.running = false;
+			return idle_wait;
+		}
+
+		ndi_send_queue_send_video(q, state, slot, now);
+		state.frame_index++;
+
+		if (now - deadline > interval * PACING_MAX_LATE_FRAMES) {
+			// Far behind schedule (the sender thread or NDI stalled): restart it from
+			// here instead of sending the backlog as a burst.
+			state.start_ns = now;
+			state.frame_index = 1;
+		}
+	}
+}
+
+static void ndi_send_queue_wait(ndi_send_queue_t *q, uint64_t wait_ns)
+{
+	// os_event_timedwait() only has millisecond resolution: wait on the event (so queued
+	// frames wake the thread) until shortly before the deadline, then sleep precisely.
+	if (wait_ns >= 2000000ULL) {
+		os_event_timedwait(q->frame_event, (unsigned long)(wait_ns / 1000000ULL) - 1);
+	} else if (wait_ns > 0) {
+		os_sleepto_ns(os_gettime_ns() + wait_ns);
+	}
+}
+
+static void *ndi_send_queue_thread(void *data)
+{
+	auto q = (ndi_send_queue_t *)data;
+	os_set_thread_name("DistroAV NDI sender");
+
+	video_send_state video_state;
+	uint64_t last_reported_drops = 0;
+	uint64_t last_reported_underruns = 0;
+	auto last_report = std::chrono::steady_clock::time_point();
+
+	for (;;) {
+		bool stopping = q->stopping.load();
+		uint64_t wait_ns = 1000000000ULL;
+
+		if (q->audio.ready) {
+			while (auto slot = q->audio.ready->pop()) {
+				ndiLib->send_send_audio_v3(q->sender, &slot->frame);
+				q->audio.free->push(slot);
+				q->audio.sent++;
+			}
+		}
+
+		if (q->video.ready) {
+			if (q->paced.load() && q->fps_num.load() && q->fps_den.load()) {
+				wait_ns = ndi_send_queue_pace_video(q, video_state, stopping);
+			} else {
+				while (auto slot = q->video.ready->pop())
+					ndi_send_queue_send_video(q, video_state, slot, os_gettime_ns());
+			}
+		}
+
+		if (stopping)
+			break;
+
+		// Report drops and underruns at most every few seconds
+		uint64_t drops = q->video.dropped.load() + q->audio.dropped.load();
+		uint64_t underruns = q->underruns.load();
+		auto now = std::chrono::steady_clock::now();
+		if ((drops != last_reported_drops || underruns != last_reported_underruns) &&
+		    now - last_report >= std::chrono::seconds(5)) {
+			last_reported_drops = drops;
+			last_reported_underruns = underruns;
+			last_report = now;
+			ndi_send_queue_log_stats(q, LOG_DEBUG);
+		}
+
+		ndi_send_queue_wait(q, wait_ns);
+	}
+
+	if (video_state.in_flight) {
+		// Wait for NDI to be done with the last async frame
+		ndiLib->send_send_video_async_v2(q->sender, nullptr);
+		q->video.free->push(video_state.in_flight);
+	}
+
+	return nullptr;
+}
+
+ndi_send_queue_t *ndi_send_queue_create(NDIlib_send_instance_t sender, const char *log_name, size_t video_frame_size,
+					size_t video_depth, size_t audio_frame_size, size_t audio_depth)
+{
+	if (!sender)
+		return nullptr;
+
+	auto q = new ndi_send_queue_t();
+	q->sender = sender;
+	q->log_name = log_name ? log_name : "";
+
+	// The sender thread holds up to 2 video slots (in flight + being submitted) and 1 audio slot.
+	q->video.init(video_frame_size, video_depth, 2);
+	q->audio.init(audio_frame_size, audio_depth, 1);
+
+	if (os_event_init(&q->frame_event, OS_EVENT_TYPE_AUTO) != 0) {
+		obs_log(LOG_DEBUG, "ndi_send_queue_create('%s'): failed to create event", q->log_name.c_str());
+		q->video.release();
+		q->audio.release();
+		delete q;
+		return nullptr;
+	}
+
+	if (pthread_create(&q->thread, nullptr, ndi_send_queue_thread, q) != 0) {
+		obs_log(LOG_DEBUG, "ndi_send_queue_create('%s'): failed to create thread", q->log_name.c_str());
+		os_event_destroy(q->frame_event);
+		q->video.release();
+		q->audio.release();
+		delete q;
+		return nullptr;
+	}
+
+	obs_log(LOG_DEBUG, "ndi_send_queue_create('%s'): video %zu x %zu bytes, audio %zu x %zu bytes",
+		q->log_name.c_str(), q->video.storage.size(), video_frame_size, q->audio.storage.size(),
+		audio_frame_size);
+
+	return q;
+}
+
+void ndi_send_queue_destroy(ndi_send_queue_t *queue)
+{
+	if (!queue)
+		return;
+
+	queue->stopping = true;
+	os_event_signal(queue->frame_event);
+	pthread_join(queue->thread, nullptr);
+	os_event_destroy(queue->frame_event);
+
+	ndi_send_queue_log_stats(queue, LOG_INFO);
+
+	queue->video.release();
+	queue->audio.release();
+	delete queue;
+}
+
+ndi_video_slot_t *ndi_send_queue_acquire_video(ndi_send_queue_t *queue)
+{
+	return queue ? queue->video.acquire() : nullptr;
+}
+
+void ndi_send_queue_push_video(ndi_send_queue_t *queue, ndi_video_slot_t *slot)
+{
+	if (!queue || !slot)
+		return;
+
+	queue->video.push(slot);
+	os_event_signal(queue->frame_event);
+}
+
+void ndi_send_queue_set_video_rate(ndi_send_queue_t *queue, uint32_t fps_num, uint32_t fps_den,
+				   ndi_send_pacing_t pacing)
+{
+	if (!queue)
+		return;
+
+	queue->fps_num = fps_num;
+	queue->fps_den = fps_den;
+	queue->paced = pacing == NDI_SEND_PACING_PACED;
+	obs_log(LOG_DEBUG, "ndi_send_queue_set_video_rate('%s'): %u/%u fps, pacing=%d", queue->log_name.c_str(),
+		fps_num, fps_den, (int)pacing);
+}
+
+ndi_audio_slot_t *ndi_send_queue_acquire_audio(ndi_send_queue_t *queue)
+{
+	return queue ? queue->audio.acquire() : nullptr;
+}
+
+void ndi_send_queue_push_audio(ndi_send_queue_t *queue, ndi_audio_slot_t *slot)
+{
+	if (!queue || !slot)
+		return;
+
+	queue->audio.push(slot);
+	os_event_signal(queue->frame_event);
+}
+
+size_t ndi_send_queue_video_frame_size(const ndi_send_queue_t *queue)
+{
+	if (!queue || queue->video.storage.empty())
+		return 0;
+	return queue->video.storage.front().size;
+}
+
+void ndi_send_queue_get_stats(const ndi_send_queue_t *queue, ndi_send_queue_stats_t *stats)
+{
+	*stats = {};
+	if (!queue)
+		return;
+
+	stats->video_sent = queue->video.sent.load();
+	stats->video_dropped = queue->video.dropped.load();
+	stats->video_depth = queue->video.ready ? queue->video.ready->size() : 0;
+	stats->video_max_depth = queue->video.max_depth.load();
+	uint64_t jitter_samples = queue->jitter_samples.load();
+	stats->video_jitter_avg_ns = jitter_samples ? queue->jitter_total_ns.load() / jitter_samples : 0;
+	stats->video_jitter_max_ns = queue->jitter_max_ns.load();
+	stats->video_underruns = queue->underruns.load();
+	uint64_t latency_samples = queue->latency_samples.load();
+	stats->video_latency_avg_ns = latency_samples ? queue->latency_total_ns.load() / latency_samples : 0;
+	stats->video_latency_max_ns = queue->latency_max_ns.load();
+	uint64_t video_sent = queue->video.sent.load();
+	stats->video_send_avg_ns = video_sent ? queue->send_total_ns.load() / video_sent : 0;
+	stats->video_send_max_ns = queue->send_max_ns.load();
+
+	stats->audio_sent = queue->audio.sent.load();
+	stats->audio_dropped = queue->audio.dropped.load();
+	stats->audio_depth = queue->audio.ready ? queue->audio.ready->size() : 0;
+	stats->audio_max_depth = queue->audio.max_depth.load();
+}
@@ -0,0 +1,116 @@
+/******************************************************************************
+	Copyright (C) 2016-2024 DistroAV <contact@distroav.org>
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation; either version 2
+	of the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, see <https://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <Processing.NDI.Lib.h>
+
+/**
+ * Dedicated sender thread for an NDI sender.
+ *
+ * The OBS output/render threads fill preallocated frame slots and push them to a
+ * bounded lock-free single-producer/single-consumer queue; a per-sender thread pops
+ * them and calls into NDI. When NDI (or the network, or a receiver) is too slow and
+ * the queue is full, the oldest queued frame is dropped so the producer never blocks.
+ *
+ * There is one producer per stream: video slots must only be acquired/pushed from
+ * one thread, and audio slots from one (possibly different) thread.
+ */
+typedef struct ndi_send_queue ndi_send_queue_t;
+
+// How video frames are spaced on the wire
+typedef enum ndi_send_pacing {
+	// Frames are sent as soon as they are queued (bursts from OBS go out back to back)
+	NDI_SEND_PACING_NONE = 0,
+	// The sender thread spaces frames evenly at the frame rate, behind a small jitter buffer
+	NDI_SEND_PACING_PACED = 1,
+	// NDI's own clocking (`clock_video`): the video send call blocks until the frame is due
+	NDI_SEND_PACING_CLOCKED = 2,
+} ndi_send_pacing_t;
+
+typedef struct ndi_video_slot {
+	NDIlib_video_frame_v2_t frame; // header to send; `frame.p_data` defaults to `data`
+	uint8_t *data;
+	size_t size;
+	uint64_t capture_ns; // os_gettime_ns() when the frame was rendered, for latency stats (0 = unknown)
+} ndi_video_slot_t;
+
+typedef struct ndi_audio_slot {
+	NDIlib_audio_frame_v3_t frame; // header to send; `frame.p_data` defaults to `data`
+	uint8_t *data;
+	size_t size;
+} ndi_audio_slot_t;
+
+typedef struct ndi_send_queue_stats {
+	uint64_t video_sent;
+	uint64_t video_dropped;
+	size_t video_depth;
+	size_t video_max_depth;
+	// Deviation of the interval between two video sends from the frame interval
+	// (only measured once the frame rate is set with ndi_send_queue_set_video_rate)
+	uint64_t video_jitter_avg_ns;
+	uint64_t video_jitter_max_ns;
+	// Paced mode: times the jitter buffer ran empty at a frame's deadline
+	uint64_t video_underruns;
+	// Time from `capture_ns` to the video send call (frames with a capture time only)
+	uint64_t video_latency_avg_ns;
+	uint64_t video_latency_max_ns;
+	// Time spent in the video send call, i.e. waiting for NDI to be done with the previous frame
+	// (and, with NDI_SEND_PACING_CLOCKED, for the frame to be due)
+	uint64_t video_send_avg_ns;
+	uint64_t video_send_max_ns;
+
+	uint64_t audio_sent;
+	uint64_t audio_dropped;
+	size_t audio_depth;
+	size_t audio_max_depth;
+} ndi_send_queue_stats_t;
+
+/**
+ * @param sender The NDI sender; must outlive the queue.
+ * @param log_name Only used for logging.
+ * @param video_frame_size Bytes per video slot (0 = no video).
+ * @param video_depth Max number of video frames waiting to be sent.
+ * @param audio_frame_size Bytes per audio slot (0 = no audio).
+ * @param audio_depth Max number of audio frames waiting to be sent.
+ */
+ndi_send_queue_t *ndi_send_queue_create(NDIlib_send_instance_t sender, const char *log_name, size_t video_frame_size,
+					size_t video_depth, size_t audio_frame_size, size_t audio_depth);
+
+// Sends what is still queued, stops the sender thread and frees all slots.
+void ndi_send_queue_destroy(ndi_send_queue_t *queue);
+
+// Get a free slot to fill. If the queue is full the oldest queued frame is dropped
+// and its slot reused. Returns null (and counts a drop) only if no slot is available at all.
+ndi_video_slot_t *ndi_send_queue_acquire_video(ndi_send_queue_t *queue);
+void ndi_send_queue_push_video(ndi_send_queue_t *queue, ndi_video_slot_t *slot);
+
+// Bytes per video slot, as given at creation (0 = no video).
+size_t ndi_send_queue_video_frame_size(const ndi_send_queue_t *queue);
+
+// Set the video frame rate, used to measure send jitter and, with NDI_SEND_PACING_PACED,
+// to schedule the video sends. Call it before the first video frame is pushed.
+void ndi_send_queue_set_video_rate(ndi_send_queue_t *queue, uint32_t fps_num, uint32_t fps_den,
+				   ndi_send_pacing_t pacing);
+
+ndi_audio_slot_t *ndi_send_queue_acquire_audio(ndi_send_queue_t *queue);
+void ndi_send_queue_push_audio(ndi_send_queue_t *queue, ndi_audio_slot_t *slot);
+
+void ndi_send_queue_get_stats(const ndi_send_queue_t *queue, ndi_send_queue_stats_t *stats);
@@ -0,0 +1,201 @@
+/******************************************************************************
+	Copyright (C) 2016-2024 DistroAV <contact@distroav.org>
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation; either version 2
+	of the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, see <https://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "ndi-sender-monitor.h"
+
+#include "plugin-main.h"
+
+#include <util/platform.h>
+#include <util/threading.h>
+
+#include <atomic>
+#include <string>
+
+// How long a single blocking wait for a first connection may last.
+// This bounds how long ndi_sender_monitor_destroy() can take.
+#define IDLE_WAIT_MS 100
+// How often to re-check the number of connections while receivers are connected.
+#define CONNECTED_CHECK_MS 1000
+// How long a single wait for a tally change may last, for the same reason as IDLE_WAIT_MS.
+#define TALLY_WAIT_MS 100
+// Metadata frames handled per wait, so a chatty receiver cannot keep the thread busy.
+#define MAX_METADATA_PER_WAIT 16
+
+struct ndi_sender_monitor {
+	NDIlib_send_instance_t sender;
+	std::string log_name;
+
+	std::atomic<int> connections{-1};
+	std::atomic<bool> on_program{false};
+	std::atomic<bool> on_preview{false};
+
+	pthread_mutex_t callback_mutex;
+	ndi_sender_monitor_tally_callback_t tally_callback;
+	void *tally_param;
+
+	pthread_t thread;
+	os_event_t *stop_event;
+};
+
+static void ndi_sender_monitor_set_tally(ndi_sender_monitor_t *m, bool on_program, bool on_preview)
+{
+	if (m->on_program.load() == on_program && m->on_preview.load() == on_preview)
+		return;
+
+	m->on_program.store(on_program);
+	m->on_preview.store(on_preview);
+	obs_log(LOG_DEBUG, "NDI sender '%s' tally: on_program=%d, on_preview=%d", m->log_name.c_str(), on_program,
+		on_preview);
+
+	pthread_mutex_lock(&m->callback_mutex);
+	if (m->tally_callback)
+		m->tally_callback(m->tally_param, on_program, on_preview);
+	pthread_mutex_unlock(&m->callback_mutex);
+}
+
+static void ndi_sender_monitor_drain_metadata(ndi_sender_monitor_t *m)
+{
+	for (int i = 0; i < MAX_METADATA_PER_WAIT; i++) {
+		NDIlib_metadata_frame_t metadata;
+		if (ndiLib->send_capture(m->sender, &metadata, 0) != NDIlib_frame_type_metadata)
+			break;
+		obs_log(LOG_DEBUG, "NDI sender '%s' received metadata: '%s'", m->log_name.c_str(),
+			metadata.p_data ? metadata.p_data : "");
+		ndiLib->send_free_metadata(m->sender, &metadata);
+	}
+}
+
+static void *ndi_sender_monitor_thread(void *data)
+{
+	auto m = (ndi_sender_monitor_t *)data;
+	os_set_thread_name("DistroAV sender monitor");
+
+	while (os_event_try(m->stop_event) == EAGAIN) {
+		int previous = m->connections.load();
+
+		// With no receivers, block until one connects (or the wait times out) so the
+		// new connection is noticed immediately. Otherwise just poll the current count.
+		int nc = ndiLib->send_get_no_connections(m->sender, previous > 0 ? 0 : IDLE_WAIT_MS);
+		m->connections.store(nc);
+
+		if (nc != previous) {
+			if (nc <= 0)
+				obs_log(LOG_DEBUG, "NDI sender '%s' has no connections.", m->log_name.c_str());
+			else if (previous <= 0)
+				obs_log(LOG_DEBUG, "NDI sender '%s' has %d connections.", m->log_name.c_str(), nc);
+		}
+
+		if (nc <= 0) {
+			ndi_sender_monitor_set_tally(m, false, false);
+			continue;
+		}
+
+		// Wait for tally changes until the next connection check
+		uint64_t next_check_ns = os_gettime_ns() + CONNECTED_CHECK_MS * 1000000ULL;
+		while (os_event_try(m->stop_event) == EAGAIN && os_gettime_ns() < next_check_ns) {
+			NDIlib_tally_t tally = {};
+			ndiLib->send_get_tally(m->sender, &tally, TALLY_WAIT_MS);
+			ndi_sender_monitor_set_tally(m, tally.on_program, tally.on_preview);
+			ndi_sender_monitor_drain_metadata(m);
+		}
+	}
+
+	return nullptr;
+}
+
+ndi_sender_monitor_t *ndi_sender_monitor_create(NDIlib_send_instance_t sender, const char *log_name)
+{
+	if (!sender)
+		return nullptr;
+
+	auto m = new ndi_sender_monitor_t();
+	m->sender = sender;
+	m->log_name = log_name ? log_name : "";
+
+	if (os_event_init(&m->stop_event, OS_EVENT_TYPE_MANUAL) != 0) {
+		obs_log(LOG_DEBUG, "ndi_sender_monitor_create('%s'): failed to create stop event", log_name);
+		delete m;
+		return nullptr;
+	}
+	pthread_mutex_init(&m->callback_mutex, nullptr);
+
+	if (pthread_create(&m->thread, nullptr, ndi_sender_monitor_thread, m) != 0) {
+		obs_log(LOG_DEBUG, "ndi_sender_monitor_create('%s'): failed to create thread", log_name);
+		pthread_mutex_destroy(&m->callback_mutex);
+		os_event_destroy(m->stop_event);
+		delete m;
+		return nullptr;
+	}
+
+	return m;
+}
+
+void ndi_sender_monitor_destroy(ndi_sender_monitor_t *monitor)
+{
+	if (!monitor)
+		return;
+
+	os_event_signal(monitor->stop_event);
+	pthread_join(monitor->thread, nullptr);
+	pthread_mutex_destroy(&monitor->callback_mutex);
+	os_event_destroy(monitor->stop_event);
+	delete monitor;
+}
+
+int ndi_sender_monitor_get_connections(const ndi_sender_monitor_t *monitor)
+{
+	return monitor ? monitor->connections.load() : -1;
+}
+
+void ndi_sender_monitor_get_tally(const ndi_sender_monitor_t *monitor, bool *on_program, bool *on_preview)
+{
+	if (on_program)
+		*on_program = monitor && monitor->on_program.load();
+	if (on_preview)
+		*on_preview = monitor && monitor->on_preview.load();
+}
+
+void ndi_sender_monitor_set_tally_callback(ndi_sender_monitor_t *monitor, ndi_sender_monitor_tally_callback_t callback,
+					   void *param)
+{
+	if (!monitor)
+		return;
+
+	pthread_mutex_lock(&monitor->callback_mutex);
+	monitor->tally_callback = callback;
+	monitor->tally_param = param;
+	pthread_mutex_unlock(&monitor->callback_mutex);
+}
+
+bool ndi_sender_monitor_should_send(const ndi_sender_monitor_t *monitor, uint64_t timestamp_ns,
+				    uint64_t *last_sent_ns, uint64_t keepalive_interval_ns)
+{
+	if (ndi_sender_monitor_get_connections(monitor) != 0) {
+		*last_sent_ns = timestamp_ns;
+		return true;
+	}
+
+	if (keepalive_interval_ns == 0)
+		return false;
+
+	if (timestamp_ns < *last_sent_ns || timestamp_ns - *last_sent_ns >= keepalive_interval_ns) {
+		*last_sent_ns = timestamp_ns;
+		return true;
+	}
+
+	return false;
+}
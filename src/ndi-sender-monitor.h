@@ -0,0 +1,59 @@
+/******************************************************************************
+	Copyright (C) 2016-2024 DistroAV <contact@distroav.org>
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation; either version 2
+	of the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, see <https://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <Processing.NDI.Lib.h>
+
+/**
+ * Watches the number of receivers connected to an NDI sender from a side thread,
+ * so the render/output paths can check for receivers without calling into NDI.
+ *
+ * While nobody is connected the thread blocks in `send_get_no_connections` with a
+ * short timeout, which returns as soon as a receiver connects. While receivers are
+ * connected it re-checks once per second to notice disconnects, and in between waits
+ * in `send_get_tally` for the receivers' tally to change (e.g. a switcher taking our
+ * feed to program) and drains the metadata they send.
+ */
+typedef struct ndi_sender_monitor ndi_sender_monitor_t;
+
+// Start monitoring `sender`. `log_name` is only used for logging.
+ndi_sender_monitor_t *ndi_sender_monitor_create(NDIlib_send_instance_t sender, const char *log_name);
+
+// Stop the monitor thread. Must be called before the sender is destroyed.
+void ndi_sender_monitor_destroy(ndi_sender_monitor_t *monitor);
+
+// Last known number of connections; -1 until the first check completed (or if monitor is null).
+int ndi_sender_monitor_get_connections(const ndi_sender_monitor_t *monitor);
+
+// Last known downstream tally. Both are false while no receiver is connected.
+void ndi_sender_monitor_get_tally(const ndi_sender_monitor_t *monitor, bool *on_program, bool *on_preview);
+
+// Called from the monitor thread whenever the tally changes. Must not destroy the monitor.
+// The callback is no longer called once ndi_sender_monitor_destroy returned.
+typedef void (*ndi_sender_monitor_tally_callback_t)(void *param, bool on_program, bool on_preview);
+void ndi_sender_monitor_set_tally_callback(ndi_sender_monitor_t *monitor, ndi_sender_monitor_tally_callback_t callback,
+					   void *param);
+
+// Helper for "idle" senders: returns true if a frame at `timestamp_ns` should be sent.
+// Frames are always sent while receivers are connected (or unknown); with no receivers,
+// only one frame per `keepalive_interval_ns` is let through (0 = none at all).
+bool ndi_sender_monitor_should_send(const ndi_sender_monitor_t *monitor, uint64_t timestamp_ns,
+				    uint64_t *last_sent_ns, uint64_t keepalive_interval_ns);
@@ -0,0 +1,145 @@
+/******************************************************************************
+	Copyright (C) 2016-2024 DistroAV <contact@distroav.org>
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation; either version 2
+	of the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, see <https://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "ndi-sender-registry.h"
+
+#include "plugin-main.h"
+
+#include <util/threading.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+struct ndi_sender_user {
+	const void *owner;
+	std::string log_name;
+};
+
+struct ndi_sender_entry {
+	std::string ndi_name;
+	std::string ndi_groups;
+	bool clock_video;
+	NDIlib_send_instance_t sender;
+	// One entry per acquire
+	std::vector<ndi_sender_user> users;
+};
+
+static pthread_mutex_t registry_mutex = PTHREAD_MUTEX_INITIALIZER;
+static std::vector<ndi_sender_entry *> registry;
+
+NDIlib_send_instance_t ndi_sender_registry_acquire(const NDIlib_send_create_t *desc, const void *owner,
+						   const char *log_name)
+{
+	if (!desc || !desc->p_ndi_name)
+		return nullptr;
+
+	std::string ndi_name = desc->p_ndi_name;
+	std::string ndi_groups = desc->p_groups ? desc->p_groups : "";
+	ndi_sender_user user = {owner, log_name ? log_name : ""};
+
+	pthread_mutex_lock(&registry_mutex);
+
+	for (auto entry : registry) {
+		if (entry->ndi_name != ndi_name)
+			continue;
+
+		// Another owner sends other content: interleaving both on one source would mix their
+		// frames, and a second sender with the same name could not be told apart by receivers
+		auto other = std::find_if(entry->users.begin(), entry->users.end(),
+					  [owner](const ndi_sender_user &u) { return u.owner != owner; });
+		if (other != entry->users.end()) {
+			obs_log(LOG_WARNING, "WARN-427 - NDI name '%s' of '%s' is already used by '%s'; not sending",
+				ndi_name.c_str(), user.log_name.c_str(), other->log_name.c_str());
+			pthread_mutex_unlock(&registry_mutex);
+			return nullptr;
+		}
+
+		// The owner's own sender, with other groups or clocking: a new sender is handed over to
+		if (entry->ndi_groups != ndi_groups || entry->clock_video != desc->clock_video)
+			continue;
+
+		entry->users.push_back(user);
+		obs_log(LOG_DEBUG, "ndi_sender_registry_acquire('%s', '%s'): reusing sender, %zu references",
+			ndi_name.c_str(), user.log_name.c_str(), entry->users.size());
+		pthread_mutex_unlock(&registry_mutex);
+		return entry->sender;
+	}
+
+	NDIlib_send_instance_t sender = ndiLib->send_create(desc);
+	if (sender) {
+		// Tells receivers (e.g. switchers listing their inputs) what is sending this feed
+		std::string product = std::string("<ndi_product long_name=\"") + PLUGIN_NAME + "\" short_name=\"" +
+				      PLUGIN_NAME + "\" manufacturer=\"DistroAV\" version=\"" + PLUGIN_VERSION +
+				      "\" model_name=\"OBS Studio " + obs_get_version_string() + "\"/>";
+		NDIlib_metadata_frame_t metadata = {};
+		metadata.p_data = (char *)product.c_str();
+		metadata.length = (int)product.size() + 1;
+		metadata.timecode = NDIlib_send_timecode_synthesize;
+		ndiLib->send_add_connection_metadata(sender, &metadata);
+
+		auto entry = new ndi_sender_entry();
+		entry->ndi_name = ndi_name;
+		entry->ndi_groups = ndi_groups;
+		entry->clock_video = desc->clock_video;
+		entry->sender = sender;
+		entry->users.push_back(user);
+		registry.push_back(entry);
+		obs_log(LOG_DEBUG, "ndi_sender_registry_acquire('%s', '%s'): created sender", ndi_name.c_str(),
+			user.log_name.c_str());
+	}
+
+	pthread_mutex_unlock(&registry_mutex);
+	return sender;
+}
+
+void ndi_sender_registry_release(NDIlib_send_instance_t sender, const void *owner)
+{
+	if (!sender)
+		return;
+
+	NDIlib_send_instance_t destroy = nullptr;
+
+	pthread_mutex_lock(&registry_mutex);
+	auto it = std::find_if(registry.begin(), registry.end(),
+			       [sender](const ndi_sender_entry *entry) { return entry->sender == sender; });
+	if (it == registry.end()) {
+		// Not created by the registry
+		destroy = sender;
+	} else {
+		auto entry = *it;
+		auto user = std::find_if(entry->users.begin(), entry->users.end(),
+					 [owner](const ndi_sender_user &u) { return u.owner == owner; });
+		if (user == entry->users.end()) {
+			obs_log(LOG_DEBUG, "ndi_sender_registry_release('%s'): unknown owner", entry->ndi_name.c_str());
+			user = entry->users.begin();
+		}
+		entry->users.erase(user);
+		obs_log(LOG_DEBUG, "ndi_sender_registry_release('%s'): %zu references left", entry->ndi_name.c_str(),
+			entry->users.size());
+		if (entry->users.empty()) {
+			destroy = entry->sender;
+			registry.erase(it);
+			delete entry;
+		}
+	}
+	pthread_mutex_unlock(&registry_mutex);
+
+	// Outside of the lock: destroying a sender waits for its pending async frame
+	if (destroy)
+		ndiLib->send_destroy(destroy);
+}
@@ -0,0 +1,43 @@
+/******************************************************************************
+	Copyright (C) 2016-2024 DistroAV <contact@distroav.org>
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation; either version 2
+	of the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, see <https://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+
+#include <Processing.NDI.Lib.h>
+
+/**
+ * Refcounted NDI senders, one per NDI name across the outputs and filters.
+ *
+ * An owner acquiring its sender again with the same name, groups and clocking gets that
+ * sender back: a user re-created with an unchanged identity (filter update, rename of an
+ * unrelated source) keeps its sender and its receivers' connections if it acquires the new
+ * sender before releasing the old one. With other groups or clocking, the owner gets a new
+ * sender to hand over to.
+ *
+ * Senders are never shared between owners, as they send different content: acquiring a
+ * name already used by another owner fails, and a warning is logged about the collision.
+ */
+
+// Same as ndiLib->send_create. `owner` identifies the caller (one reference per call) and
+// `log_name` names it in logs. Null if another owner already uses the name.
+NDIlib_send_instance_t ndi_sender_registry_acquire(const NDIlib_send_create_t *desc, const void *owner,
+						   const char *log_name);
+
+// Same as ndiLib->send_destroy once the last reference is released. Null is ignored.
+void ndi_sender_registry_release(NDIlib_send_instance_t sender, const void *owner);
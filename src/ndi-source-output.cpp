@@ -0,0 +1,412 @@
+/******************************************************************************
+	Copyright (C) 2016-2024 DistroAV <contact@distroav.org>
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation; either version 2
+	of the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, see <https://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "ndi-source-output.h"
+#include "ndi-sender-registry.h"
+
+#include "plugin-main.h"
+
+#include <util/platform.h>
+#include <util/threading.h>
+#include <util/util_uint64.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// Frames waiting for the sender thread; one is enough to absorb a slow send, more only adds latency
+#define SOURCE_OUTPUT_VIDEO_QUEUE_DEPTH 2
+// How often a source that cannot be found by name is looked up again
+#define SOURCE_OUTPUT_LOOKUP_INTERVAL_NS 1000000000ULL
+
+struct ndi_source_output {
+	std::string ndi_name;
+	std::string source_name;
+	bool program;
+
+	// Protected by outputs_mutex
+	obs_source_t *source;
+	uint64_t next_lookup_ns;
+
+	// Graphics thread only
+	gs_texrender_t *texrender;
+	gs_texrender_t *scale_texrender; // only when the output is smaller than the canvas
+	ndi_readback_t *readback;
+	uint64_t frame_count;
+	bool staged;
+
+	uint32_t canvas_width;
+	uint32_t canvas_height;
+	uint32_t width;
+	uint32_t height;
+	uint32_t frame_divisor;
+	ndi_pixel_format_t pixel_format;
+
+	// Null when sending through a queue given at creation, which is not owned
+	NDIlib_send_instance_t ndi_sender;
+	ndi_sender_monitor_t *ndi_sender_monitor;
+	ndi_send_queue_t *ndi_send_queue;
+	ndi_video_slot_t *video_slot; // acquired but not pushed yet (graphics thread only)
+	NDIlib_video_frame_v2_t video_frame_template;
+	uint64_t last_video_sent_ns;
+};
+
+// Outputs driven by the render callback, which holds the mutex for a whole render pass
+static pthread_mutex_t outputs_mutex = PTHREAD_MUTEX_INITIALIZER;
+static std::vector<ndi_source_output_t *> outputs;
+// Serializes adding and removing the render callback. Never taken on the graphics thread.
+static pthread_mutex_t callback_mutex = PTHREAD_MUTEX_INITIALIZER;
+static bool render_callback_added = false;
+
+static void ndi_source_output_render_all(void *, uint32_t, uint32_t);
+
+void ndi_source_output_get_size(uint32_t canvas_width, uint32_t canvas_height, uint32_t height, uint32_t *out_width,
+				uint32_t *out_height)
+{
+	if (height == 0 || height >= canvas_height) {
+		*out_width = canvas_width;
+		*out_height = canvas_height;
+		return;
+	}
+
+	*out_height = height & ~1u;
+	*out_width = ((uint32_t)util_mul_div64(canvas_width, *out_height, canvas_height) + 1) & ~1u;
+}
+
+static void ndi_source_output_release_source(obs_source_t *source)
+{
+	if (!source)
+		return;
+	obs_source_dec_showing(source);
+	obs_source_release(source);
+}
+
+ndi_source_output_t *ndi_source_output_create(const ndi_source_output_info_t *info)
+{
+	if (!info || !info->ndi_name || !info->ndi_name[0])
+		return nullptr;
+
+	obs_video_info ovi;
+	if (!obs_get_video_info(&ovi))
+		return nullptr;
+
+	auto o = new ndi_source_output_t();
+	o->ndi_name = info->ndi_name;
+	o->source_name = info->source_name ? info->source_name : "";
+	o->program = info->program;
+
+	if (!info->send_queue) {
+		NDIlib_send_create_t send_desc{};
+		send_desc.p_ndi_name = info->ndi_name;
+		send_desc.p_groups = info->ndi_groups && info->ndi_groups[0] ? info->ndi_groups : nullptr;
+		send_desc.clock_video = false;
+		send_desc.clock_audio = false;
+
+		const char *log_name = o->program ? "Program" : info->ndi_name;
+		if (!o->source_name.empty())
+			log_name = o->source_name.c_str();
+		o->ndi_sender = ndi_sender_registry_acquire(&send_desc, o, log_name);
+		if (!o->ndi_sender) {
+			obs_log(LOG_WARNING, "WARN-416 - NDI Sender initialisation failed. '%s'", info->ndi_name);
+			delete o;
+			return nullptr;
+		}
+	}
+
+	o->canvas_width = ovi.base_width;
+	o->canvas_height = ovi.base_height;
+	ndi_source_output_get_size(ovi.base_width, ovi.base_height, info->height, &o->width, &o->height);
+	o->frame_divisor = std::max(info->frame_divisor, 1u);
+
+	obs_enter_graphics();
+	o->texrender = gs_texrender_create(GS_BGRA, GS_ZS_NONE);
+	if (o->width != o->canvas_width || o->height != o->canvas_height)
+		o->scale_texrender = gs_texrender_create(GS_BGRA, GS_ZS_NONE);
+	o->readback = ndi_readback_create(info->ndi_name, Config::ReadbackDepth);
+	o->pixel_format = ndi_readback_effective_format(o->readback, info->pixel_format, o->width);
+	obs_leave_graphics();
+
+	// Slots of a send queue given by the caller are sized by it: checked once here, as a frame
+	// that does not fit could never be sent
+	size_t frame_size = ndi_readback_frame_size(o->pixel_format, o->width, o->height);
+	if (info->send_queue && ndi_send_queue_video_frame_size(info->send_queue) < frame_size) {
+		obs_log(LOG_ERROR, "ndi_source_output_create('%s'): %zu bytes slots too small for a %ux%u frame",
+			info->ndi_name, ndi_send_queue_video_frame_size(info->send_queue), o->width, o->height);
+		obs_enter_graphics();
+		ndi_readback_destroy(o->readback);
+		gs_texrender_destroy(o->texrender);
+		gs_texrender_destroy(o->scale_texrender);
+		obs_leave_graphics();
+		delete o;
+		return nullptr;
+	}
+
+	// Exact rational rate: e.g. 60000/1001 with a divisor of 2 is sent as 60000/2002
+	NDIlib_video_frame_v2_t video_frame = {0};
+	video_frame.xres = o->width;
+	video_frame.yres = o->height;
+	video_frame.FourCC = ndi_readback_fourcc(o->pixel_format);
+	video_frame.frame_rate_N = (int)ovi.fps_num;
+	video_frame.frame_rate_D = (int)(ovi.fps_den * o->frame_divisor);
+	video_frame.picture_aspect_ratio = 0; // square pixels
+	video_frame.frame_format_type = NDIlib_frame_format_type_progressive;
+	video_frame.timecode = NDIlib_send_timecode_synthesize;
+	video_frame.line_stride_in_bytes = (int)ndi_readback_linesize(o->pixel_format, o->width);
+	o->video_frame_template = video_frame;
+
+	if (o->ndi_sender) {
+		o->ndi_sender_monitor = ndi_sender_monitor_create(o->ndi_sender, info->ndi_name);
+		if (info->tally_callback)
+			ndi_sender_monitor_set_tally_callback(o->ndi_sender_monitor, info->tally_callback,
+							      info->tally_param);
+		o->ndi_send_queue = ndi_send_queue_create(o->ndi_sender, info->ndi_name, frame_size,
+							  SOURCE_OUTPUT_VIDEO_QUEUE_DEPTH, 0, 0);
+		ndi_send_queue_set_video_rate(o->ndi_send_queue, ovi.fps_num, ovi.fps_den * o->frame_divisor,
+					      NDI_SEND_PACING_NONE);
+	} else {
+		o->ndi_sender_monitor = info->sender_monitor;
+		o->ndi_send_queue = info->send_queue;
+	}
+
+	obs_log(LOG_DEBUG, "ndi_source_output_create('%s'): %ux%u @ %u/%u fps, format %d, source '%s'",
+		info->ndi_name, o->width, o->height, ovi.fps_num, ovi.fps_den * o->frame_divisor,
+		(int)o->pixel_format, o->program ? "(program)" : o->source_name.c_str());
+
+	pthread_mutex_lock(&outputs_mutex);
+	outputs.push_back(o);
+	pthread_mutex_unlock(&outputs_mutex);
+
+	pthread_mutex_lock(&callback_mutex);
+	if (!render_callback_added) {
+		obs_add_main_render_callback(ndi_source_output_render_all, nullptr);
+		render_callback_added = true;
+	}
+	pthread_mutex_unlock(&callback_mutex);
+
+	return o;
+}
+
+void ndi_source_output_destroy(ndi_source_output_t *output)
+{
+	if (!output)
+		return;
+
+	// Once out of the list, the render callback does not touch the output anymore
+	pthread_mutex_lock(&callback_mutex);
+	pthread_mutex_lock(&outputs_mutex);
+	outputs.erase(std::remove(outputs.begin(), outputs.end(), output), outputs.end());
+	bool last = outputs.empty();
+	obs_source_t *source = output->source;
+	output->source = nullptr;
+	pthread_mutex_unlock(&outputs_mutex);
+
+	// Not while holding outputs_mutex: OBS holds its own lock while calling the render callback
+	if (last && render_callback_added) {
+		obs_remove_main_render_callback(ndi_source_output_render_all, nullptr);
+		render_callback_added = false;
+	}
+	pthread_mutex_unlock(&callback_mutex);
+
+	ndi_source_output_release_source(source);
+
+	if (output->ndi_sender) {
+		ndi_send_queue_destroy(output->ndi_send_queue);
+		ndi_sender_monitor_destroy(output->ndi_sender_monitor);
+		ndi_sender_registry_release(output->ndi_sender, output);
+	}
+
+	obs_enter_graphics();
+	ndi_readback_destroy(output->readback);
+	gs_texrender_destroy(output->texrender);
+	gs_texrender_destroy(output->scale_texrender);
+	obs_leave_graphics();
+
+	obs_log(LOG_DEBUG, "ndi_source_output_destroy('%s')", output->ndi_name.c_str());
+	delete output;
+}
+
+void ndi_source_output_set_source(ndi_source_output_t *output, obs_source_t *source)
+{
+	if (!output)
+		return;
+
+	source = obs_source_get_ref(source);
+	if (source)
+		obs_source_inc_showing(source);
+
+	pthread_mutex_lock(&outputs_mutex);
+	obs_source_t *previous = output->source;
+	output->source = source;
+	pthread_mutex_unlock(&outputs_mutex);
+
+	ndi_source_output_release_source(previous);
+}
+
+// The program source is checked every frame, as the transition can be swapped at any time.
+// Named sources are looked up lazily, as they may be created after the output (scene collection
+// loading) or removed and re-created while it runs.
+static obs_source_t *ndi_source_output_get_source(ndi_source_output_t *o)
+{
+	if (o->program) {
+		obs_source_t *program = obs_get_output_source(0);
+		if (program == o->source) {
+			obs_source_release(program);
+		} else {
+			ndi_source_output_release_source(o->source);
+			o->source = program;
+			if (program)
+				obs_source_inc_showing(program);
+		}
+		return o->source;
+	}
+
+	if (o->source_name.empty())
+		return o->source;
+
+	if (o->source && obs_source_removed(o->source)) {
+		ndi_source_output_release_source(o->source);
+		o->source = nullptr;
+	}
+
+	uint64_t now = os_gettime_ns();
+	if (!o->source && now >= o->next_lookup_ns) {
+		o->next_lookup_ns = now + SOURCE_OUTPUT_LOOKUP_INTERVAL_NS;
+		o->source = obs_get_source_by_name(o->source_name.c_str());
+		if (o->source)
+			obs_source_inc_showing(o->source);
+	}
+	return o->source;
+}
+
+// Renders `source` to fit the canvas, keeping its aspect ratio
+static bool ndi_source_output_render_source(ndi_source_output_t *o, obs_source_t *source)
+{
+	gs_texrender_reset(o->texrender);
+	if (!gs_texrender_begin(o->texrender, o->canvas_width, o->canvas_height))
+		return false;
+
+	vec4 background;
+	vec4_zero(&background);
+	gs_clear(GS_CLEAR_COLOR, &background, 0.0f, 0);
+	gs_ortho(0.0f, (float)o->canvas_width, 0.0f, (float)o->canvas_height, -100.0f, 100.0f);
+
+	uint32_t width = source ? obs_source_get_width(source) : 0;
+	uint32_t height = source ? obs_source_get_height(source) : 0;
+	if (width && height) {
+		float scale = std::min((float)o->canvas_width / (float)width, (float)o->canvas_height / (float)height);
+
+		gs_matrix_push();
+		gs_matrix_translate3f(((float)o->canvas_width - (float)width * scale) * 0.5f,
+				      ((float)o->canvas_height - (float)height * scale) * 0.5f, 0.0f);
+		gs_matrix_scale3f(scale, scale, 1.0f);
+
+		gs_blend_state_push();
+		gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
+		obs_source_video_render(source);
+		gs_blend_state_pop();
+
+		gs_matrix_pop();
+	}
+
+	gs_texrender_end(o->texrender);
+	return true;
+}
+
+// The low resolution bilinear effect samples several texels per output pixel, which avoids
+// the aliasing of a plain bilinear draw.
+gs_texture_t *ndi_source_output_scale(gs_texrender_t *render, gs_texture_t *texture, uint32_t width, uint32_t height)
+{
+	gs_texrender_reset(render);
+	if (!gs_texrender_begin(render, width, height))
+		return nullptr;
+
+	gs_ortho(0.0f, (float)width, 0.0f, (float)height, -100.0f, 100.0f);
+
+	gs_blend_state_push();
+	gs_enable_blending(false);
+
+	gs_effect_t *effect = obs_get_base_effect(OBS_EFFECT_BILINEAR_LOWRES);
+	gs_effect_set_texture(gs_effect_get_param_by_name(effect, "image"), texture);
+	while (gs_effect_loop(effect, "Draw"))
+		gs_draw_sprite(texture, 0, width, height);
+
+	gs_blend_state_pop();
+	gs_texrender_end(render);
+	return gs_texrender_get_texture(render);
+}
+
+static void ndi_source_output_stage(ndi_source_output_t *o)
+{
+	o->staged = false;
+
+	// Skipped frames are not rendered nor read back at all
+	if (o->frame_count++ % o->frame_divisor != 0)
+		return;
+
+	obs_source_t *source = ndi_source_output_get_source(o);
+	if (!ndi_source_output_render_source(o, source))
+		return;
+
+	gs_texture_t *texture = gs_texrender_get_texture(o->texrender);
+	if (o->scale_texrender)
+		texture = ndi_source_output_scale(o->scale_texrender, texture, o->width, o->height);
+	if (!texture)
+		return;
+
+	o->staged = ndi_readback_stage(o->readback, texture, o->width, o->height, o->pixel_format, os_gettime_ns());
+}
+
+static void ndi_source_output_send(ndi_source_output_t *o)
+{
+	uint64_t timestamp;
+	if (!o->staged || !ndi_readback_ready(o->readback, &timestamp))
+		return;
+
+	// With no receivers, the frame is left in the readback ring and dropped on the next stage
+	if (!ndi_sender_monitor_should_send(o->ndi_sender_monitor, timestamp, &o->last_video_sent_ns, 1000000000ULL))
+		return;
+
+	// A slot that could not be filled is kept for the next frame, as it cannot be given back
+	if (!o->video_slot)
+		o->video_slot = ndi_send_queue_acquire_video(o->ndi_send_queue);
+	auto slot = o->video_slot;
+	if (!slot)
+		return;
+
+	slot->frame = o->video_frame_template;
+	slot->frame.p_data = slot->data;
+	slot->capture_ns = timestamp;
+	if (!ndi_readback_download(o->readback, slot->data, (uint32_t)slot->frame.line_stride_in_bytes))
+		return;
+
+	o->video_slot = nullptr;
+	ndi_send_queue_push_video(o->ndi_send_queue, slot);
+}
+
+static void ndi_source_output_render_all(void *, uint32_t, uint32_t)
+{
+	pthread_mutex_lock(&outputs_mutex);
+
+	// Queue all GPU work first, then map: by the time the first output maps its oldest
+	// staged frame, the copies of every output for this frame are already submitted.
+	for (auto o : outputs)
+		ndi_source_output_stage(o);
+	for (auto o : outputs)
+		ndi_source_output_send(o);
+
+	pthread_mutex_unlock(&outputs_mutex);
+}
@@ -0,0 +1,77 @@
+/******************************************************************************
+	Copyright (C) 2016-2024 DistroAV <contact@distroav.org>
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation; either version 2
+	of the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, see <https://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "ndi-readback.h"
+#include "ndi-sender-monitor.h"
+#include "ndi-send-queue.h"
+
+/**
+ * NDI output fed by rendering an OBS source on the graphics thread, instead of by an
+ * obs_output: the source is rendered to fit the canvas, scaled down on the GPU if the
+ * output is smaller, packed and read back through a ndi_readback ring, and handed to
+ * a ndi_send_queue whose thread calls into NDI.
+ *
+ * All source outputs are driven by a single main render callback, which first renders
+ * and stages every output due this frame, then downloads and queues the frames whose
+ * readback is ready. Mapping thus never waits on a copy queued in the same frame, for
+ * any number of outputs.
+ *
+ * Creating, destroying and setting the source must not happen on the graphics thread.
+ */
+typedef struct ndi_source_output ndi_source_output_t;
+
+typedef struct ndi_source_output_info {
+	const char *ndi_name;
+	const char *ndi_groups;
+	// Source rendered by the output, looked up by name (and again if it is removed and
+	// re-created). Null to set the source with ndi_source_output_set_source instead.
+	const char *source_name;
+	// Output height, the width following the canvas aspect ratio (0 = canvas size)
+	uint32_t height;
+	ndi_pixel_format_t pixel_format;
+	// Only every Nth canvas frame is rendered and sent (0 or 1 = canvas frame rate)
+	uint32_t frame_divisor;
+	// Render the program (output channel 0, following transition changes) instead of a source
+	bool program;
+	// Queue frames to an existing sender instead of creating one, e.g. one also sending the
+	// audio of an obs_output. Both must outlive the source output. Video slots must hold a
+	// BGRA frame of the output size, the format the readback falls back to.
+	ndi_send_queue_t *send_queue;
+	ndi_sender_monitor_t *sender_monitor;
+	// Called from the sender monitor thread when the downstream tally changes (optional). Not
+	// used with `send_queue`, the tally then being reported by the given sender monitor.
+	ndi_sender_monitor_tally_callback_t tally_callback;
+	void *tally_param;
+} ndi_source_output_info_t;
+
+// Returns null if the NDI sender could not be created, or if the video slots of `send_queue`
+// are too small for the output's frames. `ndi_name` is still required with `send_queue`, for logging.
+ndi_source_output_t *ndi_source_output_create(const ndi_source_output_info_t *info);
+void ndi_source_output_destroy(ndi_source_output_t *output);
+
+// Render `source` from now on (a new reference is taken), or nothing if null.
+void ndi_source_output_set_source(ndi_source_output_t *output, obs_source_t *source);
+
+// Output size for a configured `height` (0 = canvas), keeping the canvas aspect ratio. Never
+// larger than the canvas, and even sized so it can be packed to UYVY.
+void ndi_source_output_get_size(uint32_t canvas_width, uint32_t canvas_height, uint32_t height, uint32_t *out_width,
+				uint32_t *out_height);
+
+// Downscales `texture` to `width` x `height` into `render` (graphics context required).
+gs_texture_t *ndi_source_output_scale(gs_texrender_t *render, gs_texture_t *texture, uint32_t width, uint32_t height);
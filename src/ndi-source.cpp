@@ -28,6 +28,8 @@
 #include <thread>
 
 #define PROP_SOURCE "ndi_source_name"
+#define PROP_DISCOVERY_GROUPS "ndi_discovery_groups"
+#define PROP_DISCOVERY_EXTRA_IPS "ndi_discovery_extra_ips"
 #define PROP_BEHAVIOR "ndi_behavior"
 #define PROP_TIMEOUT "ndi_behavior_timeout"
 #define PROP_BANDWIDTH "ndi_bw_mode"
@@ -113,6 +115,9 @@ typedef struct ndi_source_config_t {
 	bool audio_enabled;
 	ptz_t ptz;
 	NDIlib_tally_t tally;
+	// Where the source list of the properties is discovered
+	char *discovery_groups;
+	char *discovery_extra_ips;
 } ndi_source_config_t;
 
 typedef struct ndi_source_t {
@@ -126,8 +131,25 @@ typedef struct ndi_source_t {
 	uint32_t height;
 
 	uint64_t last_frame_timestamp;
+
+	// Hashes of the source list last discovered (set by the discovery thread) and of the one
+	// the properties were last built with: the properties are reloaded from the tick when
+	// they differ, at most once per SOURCE_PROPERTIES_REFRESH_INTERVAL_NS
+	volatile long discovered_sources_hash;
+	volatile long shown_sources_hash;
+	uint64_t last_properties_refresh_ns;
 } ndi_source_t;
 
+#define SOURCE_PROPERTIES_REFRESH_INTERVAL_NS 2000000000ULL
+
+static long ndi_source_list_hash(const std::vector<std::string> &sources)
+{
+	size_t hash = sources.size();
+	for (auto &source : sources)
+		hash = hash * 31 + std::hash<std::string>()(source);
+	return (long)hash;
+}
+
 static obs_source_t *find_filter_by_id(obs_source_t *context, const char *id)
 {
 	if (!context)
@@ -222,19 +244,27 @@ obs_properties_t *ndi_source_getproperties(void *data)
 	obs_property_t *source_list = obs_properties_add_list(props, PROP_SOURCE,
 							      obs_module_text("NDIPlugin.SourceProps.SourceName"),
 							      OBS_COMBO_TYPE_EDITABLE, OBS_COMBO_FORMAT_STRING);
-	NDIFinder finder;
-	// Create a callback that is called when the NDI source list is complete
-	auto finder_callback = [source_list, s](void *ndi_names) {
-		auto ndi_sources = (std::vector<std::string> *)ndi_names;
-		for (auto &source : *ndi_sources) {
-			obs_property_list_add_string(source_list, source.c_str(), source.c_str());
-		}
-		obs_source_update_properties(s->obs_source);
-	};
-	auto ndi_sources = finder.getNDISourceList(finder_callback);
+	// The list is kept current by the discovery of the source's groups and extra IPs, which
+	// refreshes the properties on changes
+	const char *groups = s && s->config.discovery_groups ? s->config.discovery_groups : "";
+	const char *extra_ips = s && s->config.discovery_extra_ips ? s->config.discovery_extra_ips : "";
+	auto ndi_sources = NDIFinder::getNDISourceList(groups, extra_ips);
 	for (auto &source : ndi_sources) {
 		obs_property_list_add_string(source_list, source.c_str(), source.c_str());
 	}
+	if (s)
+		os_atomic_set_long(&s->shown_sources_hash, ndi_source_list_hash(ndi_sources));
+
+	obs_property_t *discovery_groups =
+		obs_properties_add_text(props, PROP_DISCOVERY_GROUPS,
+					obs_module_text("NDIPlugin.SourceProps.DiscoveryGroups"), OBS_TEXT_DEFAULT);
+	obs_property_set_long_description(discovery_groups,
+					  obs_module_text("NDIPlugin.SourceProps.DiscoveryGroups.Description"));
+	obs_property_t *discovery_extra_ips =
+		obs_properties_add_text(props, PROP_DISCOVERY_EXTRA_IPS,
+					obs_module_text("NDIPlugin.SourceProps.DiscoveryExtraIPs"), OBS_TEXT_DEFAULT);
+	obs_property_set_long_description(discovery_extra_ips,
+					  obs_module_text("NDIPlugin.SourceProps.DiscoveryExtraIPs.Description"));
 
 	obs_property_t *behavior_list = obs_properties_add_list(props, PROP_BEHAVIOR,
 								obs_module_text("NDIPlugin.SourceProps.Behavior"),
@@ -1077,6 +1107,20 @@ void ndi_source_update(void *data, obs_data_t *settings)
 	float zoom = (float)obs_data_get_double(settings, PROP_ZOOM);
 	s->config.ptz = ptz_t(ptz_enabled, pan, tilt, zoom);
 
+	// Only the discovery of these groups and extra IPs is queried for the source list, and
+	// sources appearing or disappearing there refresh an open properties dialog (from the tick)
+	auto discovery_groups = obs_data_get_string(settings, PROP_DISCOVERY_GROUPS);
+	auto discovery_extra_ips = obs_data_get_string(settings, PROP_DISCOVERY_EXTRA_IPS);
+	bfree(s->config.discovery_groups);
+	bfree(s->config.discovery_extra_ips);
+	s->config.discovery_groups = bstrdup(discovery_groups);
+	s->config.discovery_extra_ips = bstrdup(discovery_extra_ips);
+	NDIFinder::addListener(s, discovery_groups, discovery_extra_ips,
+			       [s](const std::vector<std::string> &sources, const std::vector<std::string> &,
+				   const std::vector<std::string> &) {
+				       os_atomic_set_long(&s->discovered_sources_hash, ndi_source_list_hash(sources));
+			       });
+
 	// Update tally status
 	s->config.tally.on_preview = tally_on_preview(obs_source);
 	s->config.tally.on_program = tally_on_program(obs_source);
@@ -1189,6 +1233,24 @@ void on_ndi_source_renamed(void *data, calldata_t *)
 		s->config.ndi_receiver_name);
 }
 
+// Reloads open properties when the discovered sources differ from the listed ones. Changes in a
+// burst are coalesced, so a dialog being edited is not rebuilt for every source coming and going.
+void ndi_source_tick(void *data, float)
+{
+	auto s = (ndi_source_t *)data;
+	if (os_atomic_load_long(&s->discovered_sources_hash) == os_atomic_load_long(&s->shown_sources_hash))
+		return;
+
+	uint64_t now = os_gettime_ns();
+	if (now - s->last_properties_refresh_ns < SOURCE_PROPERTIES_REFRESH_INTERVAL_NS)
+		return;
+
+	s->last_properties_refresh_ns = now;
+	// Considered shown until the properties are rebuilt, which only happens if they are open
+	os_atomic_set_long(&s->shown_sources_hash, os_atomic_load_long(&s->discovered_sources_hash));
+	obs_source_update_properties(s->obs_source);
+}
+
 void *ndi_source_create(obs_data_t *settings, obs_source_t *obs_source)
 {
 	auto obs_source_name = obs_source_get_name(obs_source);
@@ -1217,6 +1279,8 @@ void ndi_source_destroy(void *data)
 	auto sh = obs_source_get_signal_handler(s->obs_source);
 	signal_handler_disconnect(sh, "rename", on_ndi_source_renamed, s);
 
+	NDIFinder::removeListener(s);
+
 	ndi_source_thread_stop(s);
 
 	if (s->config.ndi_receiver_name) {
@@ -1229,6 +1293,11 @@ void ndi_source_destroy(void *data)
 		s->config.ndi_source_name = nullptr;
 	}
 
+	bfree(s->config.discovery_groups);
+	bfree(s->config.discovery_extra_ips);
+	s->config.discovery_groups = nullptr;
+	s->config.discovery_extra_ips = nullptr;
+
 	bfree(s);
 
 	obs_log(LOG_DEBUG, "'%s' -ndi_source_destroy(…)", obs_source_name);
@@ -1251,6 +1320,7 @@ obs_source_info create_ndi_source_info()
 	ndi_source_info.activate = ndi_source_activated;
 	ndi_source_info.show = ndi_source_shown;
 	ndi_source_info.update = ndi_source_update;
+	ndi_source_info.video_tick = ndi_source_tick;
 	ndi_source_info.hide = ndi_source_hidden;
 	ndi_source_info.deactivate = ndi_source_deactivated;
 	ndi_source_info.destroy = ndi_source_destroy;
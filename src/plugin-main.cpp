@@ -23,6 +23,8 @@
 #include "forms/update.h"
 #include "main-output.h"
 #include "preview-output.h"
+#include "aux-output.h"
+#include "ndi-finder.h"
 
 #include <QAction>
 #include <QDir>
@@ -56,6 +58,12 @@ struct obs_source_info ndi_source_info;
 extern struct obs_output_info create_ndi_output_info();
 struct obs_output_info ndi_output_info;
 
+extern struct obs_output_info create_ndi_alpha_output_info();
+struct obs_output_info ndi_alpha_output_info;
+
+extern struct obs_output_info create_ndi_preview_output_info();
+struct obs_output_info ndi_preview_output_info;
+
 extern struct obs_output_info create_test_output_info();
 struct obs_output_info test_output_info;
 
@@ -266,6 +274,12 @@ static void register_plugin_features()
 	ndi_output_info = create_ndi_output_info();
 	obs_register_output(&ndi_output_info);
 
+	ndi_alpha_output_info = create_ndi_alpha_output_info();
+	obs_register_output(&ndi_alpha_output_info);
+
+	ndi_preview_output_info = create_ndi_preview_output_info();
+	obs_register_output(&ndi_preview_output_info);
+
 	test_output_info = create_test_output_info();
 	obs_register_output(&test_output_info);
 
@@ -450,6 +464,10 @@ bool obs_module_load(void)
 
 				// All seems compatible, proceed to register plugin features.
 				register_plugin_features();
+
+				// Discover NDI sources in the background from now on, so that the source
+				// properties open with a current list
+				NDIFinder::start();
 			}
 		}
 	}
@@ -483,19 +501,23 @@ bool obs_module_load(void)
 						[] {
 							main_output_init();
 							preview_output_init();
+							aux_outputs_init();
 						},
 						Qt::QueuedConnection);
 				} else if (event == OBS_FRONTEND_EVENT_EXIT) {
 					// Unknown why putting this in obs_module_unload causes a crash when closing OBS
 					main_output_deinit();
 					preview_output_deinit();
+					aux_outputs_deinit();
 				} else if (event == OBS_FRONTEND_EVENT_PROFILE_CHANGING) {
 					main_output_deinit();
 					preview_output_deinit();
+					aux_outputs_deinit();
 				} else if (event == OBS_FRONTEND_EVENT_PROFILE_CHANGED) {
 					if (plugin_features_registered) {
 						main_output_init();
 						preview_output_init();
+						aux_outputs_init();
 					}
 				}
 			},
@@ -526,6 +548,9 @@ void obs_module_unload(void)
 
 	updateCheckStop();
 
+	// Uses the NDI library
+	NDIFinder::stop();
+
 	if (ndiLib) {
 		ndiLib->destroy();
 		ndiLib = nullptr;
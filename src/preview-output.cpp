@@ -18,31 +18,49 @@
 #include "preview-output.h"
 
 #include "plugin-main.h"
+#include "ndi-source-output.h"
 
-#include <util/platform.h>
-#include <media-io/video-frame.h>
+#include <algorithm>
+#include <atomic>
 
 struct preview_output {
 	QString ndi_name;
 	QString ndi_groups;
 
 	obs_source_t *current_source;
+
+	// Control only: starting and stopping it (e.g. remotely from obs-websocket) starts and
+	// stops the source output. It takes no audio nor video from OBS.
 	obs_output_t *output;
 
-	video_t *video_queue;
-	audio_t *dummy_audio_queue; // unused for now
-	gs_texrender_t *texrender;
-	gs_stagesurf_t *stagesurface;
-	uint8_t *video_data;
-	uint32_t video_linesize;
+	// Frames are rendered and sent by a source output, with no video_output or audio_output in
+	// between the render callback and NDI
+	ndi_source_output_t *source_output;
 
-	obs_video_info ovi;
+	// Configured output height (0 = canvas) and frame rate divisor
+	int resolution;
+	int frame_divisor;
 };
 
 static struct preview_output context = {0};
 
+// Set from the source output's sender monitor thread
+static std::atomic<bool> tally_on_program{false};
+static std::atomic<bool> tally_on_preview{false};
+
+void preview_output_get_tally(bool *on_program, bool *on_preview)
+{
+	*on_program = tally_on_program.load();
+	*on_preview = tally_on_preview.load();
+}
+
+static void on_preview_output_tally(void *, bool on_program, bool on_preview)
+{
+	tally_on_program.store(on_program);
+	tally_on_preview.store(on_preview);
+}
+
 void on_preview_scene_changed(enum obs_frontend_event event, void *param);
-void render_preview_source(void *param, uint32_t cx, uint32_t cy);
 
 void on_preview_output_started(void *, calldata_t *)
 {
@@ -58,6 +76,96 @@ void on_preview_output_stopped(void *, calldata_t *)
 	obs_log(LOG_DEBUG, "-on_preview_output_stopped()");
 }
 
+static const char *ndi_preview_output_getname(void *)
+{
+	return obs_module_text("NDIPlugin.PreviewOutputName");
+}
+
+static void *ndi_preview_output_create(obs_data_t *, obs_output_t *output)
+{
+	context.output = output;
+	return &context;
+}
+
+static void ndi_preview_output_destroy(void *) {}
+
+static void ndi_preview_output_release(struct preview_output *ctx)
+{
+	if (!ctx->source_output)
+		return;
+
+	obs_frontend_remove_event_callback(on_preview_scene_changed, ctx);
+
+	ndi_source_output_destroy(ctx->source_output);
+	ctx->source_output = nullptr;
+	tally_on_program.store(false);
+	tally_on_preview.store(false);
+
+	obs_source_release(ctx->current_source);
+	ctx->current_source = nullptr;
+}
+
+static bool ndi_preview_output_start(void *data)
+{
+	auto ctx = (struct preview_output *)data;
+
+	// Kept alive until the output is created
+	QByteArray name = ctx->ndi_name.toUtf8();
+	QByteArray groups = ctx->ndi_groups.toUtf8();
+
+	// The preview is packed to UYVY on the GPU, like the main output sends 4:2:0/4:2:2 video
+	ndi_source_output_info_t info = {};
+	info.ndi_name = name.constData();
+	info.ndi_groups = groups.isEmpty() ? nullptr : groups.constData();
+	info.height = (uint32_t)std::max(ctx->resolution, 0);
+	info.pixel_format = NDI_PIXEL_FORMAT_UYVY;
+	info.frame_divisor = (uint32_t)std::max(ctx->frame_divisor, 1);
+	info.tally_callback = on_preview_output_tally;
+
+	ctx->source_output = ndi_source_output_create(&info);
+	if (!ctx->source_output)
+		return false;
+
+	obs_frontend_add_event_callback(on_preview_scene_changed, ctx);
+	if (obs_frontend_preview_program_mode_active()) {
+		ctx->current_source = obs_frontend_get_current_preview_scene();
+	} else {
+		ctx->current_source = obs_frontend_get_current_scene();
+	}
+	ndi_source_output_set_source(ctx->source_output, ctx->current_source);
+
+	// No flags: nothing is captured, this only marks the output active and signals "start"
+	if (!obs_output_begin_data_capture(ctx->output, 0)) {
+		ndi_preview_output_release(ctx);
+		return false;
+	}
+	return true;
+}
+
+static void ndi_preview_output_stop(void *data, uint64_t)
+{
+	auto ctx = (struct preview_output *)data;
+
+	obs_output_end_data_capture(ctx->output);
+	ndi_preview_output_release(ctx);
+}
+
+obs_output_info create_ndi_preview_output_info()
+{
+	obs_output_info ndi_preview_output_info = {};
+	ndi_preview_output_info.id = "ndi_preview_output";
+	ndi_preview_output_info.flags = 0;
+
+	ndi_preview_output_info.get_name = ndi_preview_output_getname;
+
+	ndi_preview_output_info.create = ndi_preview_output_create;
+	ndi_preview_output_info.start = ndi_preview_output_start;
+	ndi_preview_output_info.stop = ndi_preview_output_stop;
+	ndi_preview_output_info.destroy = ndi_preview_output_destroy;
+
+	return ndi_preview_output_info;
+}
+
 void preview_output_stop()
 {
 	obs_log(LOG_DEBUG, "+preview_output_stop()");
@@ -66,21 +174,6 @@ void preview_output_stop()
 			QT_TO_UTF8(context.ndi_name));
 		obs_output_stop(context.output);
 
-		video_output_stop(context.video_queue);
-
-		obs_remove_main_render_callback(render_preview_source, &context);
-		obs_frontend_remove_event_callback(on_preview_scene_changed, &context);
-
-		obs_source_release(context.current_source);
-
-		obs_enter_graphics();
-		gs_stagesurface_destroy(context.stagesurface);
-		gs_texrender_destroy(context.texrender);
-		obs_leave_graphics();
-
-		video_output_close(context.video_queue);
-		audio_output_close(context.dummy_audio_queue);
-
 		obs_log(LOG_DEBUG, "preview_output_stop: successfully stopped NDI preview output '%s'",
 			QT_TO_UTF8(context.ndi_name));
 	} else {
@@ -101,69 +194,11 @@ void preview_output_start()
 		obs_log(LOG_DEBUG, "preview_output_start: starting NDI preview output '%s'",
 			QT_TO_UTF8(context.ndi_name));
 
-		obs_get_video_info(&context.ovi);
-
-		uint32_t width = context.ovi.base_width;
-		uint32_t height = context.ovi.base_height;
-
-		obs_enter_graphics();
-		context.texrender = gs_texrender_create(GS_BGRA, GS_ZS_NONE);
-		context.stagesurface = gs_stagesurface_create(width, height, GS_BGRA);
-		obs_leave_graphics();
-
-		const video_output_info *mainVOI = video_output_get_info(obs_get_video());
-		const audio_output_info *mainAOI = audio_output_get_info(obs_get_audio());
-
-		video_output_info voi = {0};
-		voi.name = bstrdup(QT_TO_UTF8(context.ndi_name));
-		voi.format = VIDEO_FORMAT_BGRA;
-		voi.width = width;
-		voi.height = height;
-		voi.fps_den = context.ovi.fps_den;
-		voi.fps_num = context.ovi.fps_num;
-		voi.cache_size = 16;
-		voi.colorspace = mainVOI->colorspace;
-		voi.range = mainVOI->range;
-
-		video_output_open(&context.video_queue, &voi);
-
-		audio_output_info aoi = {0};
-		aoi.name = bstrdup(QT_TO_UTF8(context.ndi_name));
-		aoi.format = mainAOI->format;
-		aoi.samples_per_sec = mainAOI->samples_per_sec;
-		aoi.speakers = mainAOI->speakers;
-		aoi.input_callback = [](void *, uint64_t, uint64_t, uint64_t *, uint32_t, struct audio_output_data *) {
-			return false;
-		};
-		aoi.input_param = nullptr;
-
-		audio_output_open(&context.dummy_audio_queue, &aoi);
-
-		obs_frontend_add_event_callback(on_preview_scene_changed, &context);
-		if (obs_frontend_preview_program_mode_active()) {
-			context.current_source = obs_frontend_get_current_preview_scene();
-		} else {
-			context.current_source = obs_frontend_get_current_scene();
-		}
-		obs_add_main_render_callback(render_preview_source, &context);
-
-		obs_data_t *settings = obs_output_get_settings(context.output);
-		obs_data_set_string(settings, "ndi_name", QT_TO_UTF8(context.ndi_name));
-		obs_data_set_string(settings, "ndi_groups", QT_TO_UTF8(context.ndi_groups));
-		obs_output_update(context.output, settings);
-		obs_data_release(settings);
-
-		obs_output_set_media(context.output, context.video_queue, context.dummy_audio_queue);
-
 		obs_output_start(context.output);
 		if (obs_output_active(context.output)) {
 			obs_log(LOG_DEBUG, "preview_output_start: successfully started NDI preview output '%s'",
 				QT_TO_UTF8(context.ndi_name));
 		} else {
-			auto error = obs_output_get_last_error(context.output);
-			obs_log(LOG_WARNING,
-				"preview_output_start: failed to start NDI preview output '%s'; error='%s'",
-				QT_TO_UTF8(context.ndi_name), error);
 			obs_log(LOG_ERROR, "ERR-400 - Failed to start NDI preview output '%s'",
 				QT_TO_UTF8(context.ndi_name));
 			// Could not start Output, still trigger it to stop.
@@ -197,8 +232,7 @@ void preview_output_deinit()
 		context.output = nullptr;
 		context.ndi_name.clear();
 		context.ndi_groups.clear();
-		obs_log(LOG_DEBUG, "preview_output_deinit: successfully released NDI preview output '%s'",
-			QT_TO_UTF8(context.ndi_name));
+		obs_log(LOG_DEBUG, "preview_output_deinit: released NDI preview output");
 	} else {
 		obs_log(LOG_DEBUG, "preview_output_deinit: NDI preview output is not initialized. Nothing to deinit.");
 	}
@@ -219,31 +253,20 @@ void preview_output_init()
 
 	if (is_enabled && !output_name.isEmpty()) {
 		obs_log(LOG_DEBUG, "preview_output_init: creating NDI Preview Output '%s'", QT_TO_UTF8(output_name));
-		obs_data_t *output_settings = obs_data_create();
-		obs_data_set_string(output_settings, "ndi_name", QT_TO_UTF8(output_name));
-		obs_data_set_string(output_settings, "ndi_groups", QT_TO_UTF8(output_groups));
-
-		obs_data_set_bool(output_settings, "uses_audio",
-				  false); // Preview has no audio
+		context.ndi_name = output_name;
+		context.ndi_groups = output_groups;
+		context.resolution = config->PreviewOutputResolution;
+		context.frame_divisor = config->PreviewOutputFrameDivisor;
 
-		context.output = obs_output_create("ndi_output", "NDI Preview Output", output_settings, nullptr);
-		obs_data_release(output_settings);
+		context.output = obs_output_create("ndi_preview_output", "NDI Preview Output", nullptr, nullptr);
 		if (context.output) {
-			obs_log(LOG_DEBUG, "preview_output_init: Successfully created NDI Preview Output '%s'",
-				QT_TO_UTF8(output_name));
-
 			// Start handling "remote" start/stop events (ex: from obs-websocket)
 			auto sh = obs_output_get_signal_handler(context.output);
 			signal_handler_connect(sh, "start", on_preview_output_started, nullptr);
 			signal_handler_connect(sh, "stop", on_preview_output_stopped, nullptr);
-
-			context.ndi_name = output_name;
-			context.ndi_groups = output_groups;
 		} else {
 			obs_log(LOG_WARNING, "WARN-423 - Failed to create NDI Preview Output '%s'",
 				QT_TO_UTF8(output_name));
-			obs_log(LOG_DEBUG, "preview_output_init: failed to create NDI Preview Output '%s'",
-				QT_TO_UTF8(output_name));
 		}
 		preview_output_start();
 	}
@@ -276,54 +299,9 @@ void on_preview_scene_changed(enum obs_frontend_event event, void *param)
 		ctx->current_source = nullptr;
 		break;
 	default:
-		break;
-	}
-}
-
-void render_preview_source(void *param, uint32_t, uint32_t)
-{
-	auto ctx = (struct preview_output *)param;
-	if (!ctx->current_source)
 		return;
-
-	uint32_t width = obs_source_get_base_width(ctx->current_source);
-	uint32_t height = obs_source_get_base_height(ctx->current_source);
-
-	gs_texrender_reset(ctx->texrender);
-
-	if (gs_texrender_begin(ctx->texrender, width, height)) {
-		struct vec4 background;
-		vec4_zero(&background);
-
-		gs_clear(GS_CLEAR_COLOR, &background, 0.0f, 0);
-		gs_ortho(0.0f, (float)width, 0.0f, (float)height, -100.0f, 100.0f);
-
-		gs_blend_state_push();
-		gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
-
-		obs_source_video_render(ctx->current_source);
-
-		gs_blend_state_pop();
-		gs_texrender_end(ctx->texrender);
-
-		struct video_frame output_frame;
-		if (video_output_lock_frame(ctx->video_queue, &output_frame, 1, os_gettime_ns())) {
-			gs_stage_texture(ctx->stagesurface, gs_texrender_get_texture(ctx->texrender));
-
-			if (gs_stagesurface_map(ctx->stagesurface, &ctx->video_data, &ctx->video_linesize)) {
-				uint32_t linesize = output_frame.linesize[0];
-				for (uint32_t i = 0; i < ctx->ovi.base_height; i++) {
-					uint32_t dst_offset = linesize * i;
-					uint32_t src_offset = ctx->video_linesize * i;
-					memcpy(output_frame.data[0] + dst_offset, ctx->video_data + src_offset,
-					       linesize);
-				}
-
-				gs_stagesurface_unmap(ctx->stagesurface);
-				ctx->video_data = nullptr;
-			}
-
-			video_output_unlock_frame(ctx->video_queue);
-		}
 	}
+
+	if (ctx->source_output)
+		ndi_source_output_set_source(ctx->source_output, ctx->current_source);
 }
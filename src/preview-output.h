@@ -19,3 +19,5 @@
 
 void preview_output_deinit();
 void preview_output_init();
+// Downstream tally of the preview output, false for both while it is not running
+void preview_output_get_tally(bool *on_program, bool *on_preview);